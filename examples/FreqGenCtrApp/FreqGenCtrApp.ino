@@ -48,12 +48,26 @@
         F1<CR>        To wait for the next reading and then read the 
                       frequency counter.
         FS<CR>        See if a new frequency counter value is ready. (1=yes,0=no)
-        T[0..9]<CR>   Set the frequency counter gate time to off...10sec,ext
+        F2<CR>        Wait for and read both inputs (D6 and D12, if FCCHANNEL2 in 
+                      FrequencyCounter.h)
+        T[0..12]<CR>  Set the frequency counter gate time to off...10sec,ext
                       0=off, 1=1sec, 2=10mS, 3=100mS, 4=10S, 5=100S, 6=ext                      
                       7=Period mode, 8=Period(10 avg), 9=Period(100 avg)
+                      10=1sec, 11=10mS, 12=100mS timer gate (D5 to D9)
+                      (ext gate input is D9 [PB5], D13 on an Uno, D11 on a Mega)
         T<CR>         Get the current gate time (returned value same as set value)
         R<CR>         Turn on/off automatic reporting of the frequency read by 
                       the frequency counter.  
+        I<CR>         Show the ISR time statistics (if ISRSTATS in ISRStats.h)
+        IC<CR>        Clear the ISR time statistics.
+        L<CR>         Show the CPU load over the last second (if ISRLOAD too)
+        D<CR>         Dump the frequency counter event trace (if FCTRACE in 
+                      FrequencyCounter.h)
+        B[1..16]<CR>  Capture the next 1..16 ext gates (mode 6, 10..12).
+        B<CR>         Show the captured ext gates.
+        P[n]<CR>      Count batches of n pulses, toggle the OCxA pin at the end 
+                      of each (if FCPRESET in FrequencyCounter.h).  P0 stops. 
+        P<CR>         Show the number of batches done.
 
         ?             Show help info.
 
@@ -114,6 +128,8 @@ FrequencyGenerator FG;
 FrequencyCounter FC; 
 #endif
 
+#include "ISRStats.h"           // (Only used if ISRSTATS is defined there)
+
 
 #if FREEIF
 // Define I/O bits used for each of the four switches. 
@@ -142,6 +158,7 @@ FrequencyCounter FC;
 //      Gate: 1 Sec (3)
 //      Gate: 0.1S  (3)
 //      Gate: EXT   (6)
+//      Gate: T 1S  (10)
 //      #Avgs: 100  (9)
 //     XXXXXXXXXXXXXXXX
 //     Gen=2000000  Hz
@@ -200,6 +217,84 @@ void SetFreqGenfromIndex(byte Idx)
 }
 #endif  // FREQGEN
 
+#if COMIF && ISRSTATS
+// Names of the ISRs (ISRID_ order) for the 'I' and 'L' commands
+static const char Names[] PROGMEM = "SysTmr\0Gate  \0CtrOvf\0PCInt \0GateEd";
+
+void ShowISRStats(void)
+  // Show the ISR time statistics.  (the 'I' command)
+{
+  ISRStat St;  byte i,j;
+  printfROM("Times are in timer ticks (%u nS each)\n",
+            (unsigned)(1000000000UL/SYSTIMERTICKSPERSEC));
+  printfROM("ISR       Count  Mean   Max  Lat:Mean   Max  Histogram (0,1,2,4,8..)\n");
+  for (i=0; i<ISRIDS; i++)
+  {
+    ISRStatGet(i,&St);
+    printfROM("%S %8lu %5u %5u",Names+i*7,St.count,
+              St.count?(unsigned)(St.sum/St.count):0,St.max);
+    if (St.latcount) 
+      printfROM("      %5u %5u  ",(unsigned)(St.latsum/St.latcount),St.latmax);
+    else printfROM("          -     -  ");
+    for (j=0; j<ISRSTATBINS; j++) printfROM(" %u",St.hist[j]);
+    printfROM("\n");
+    if (St.latcount) 
+    {
+      printfROM("  (latency histogram)                         ");
+      for (j=0; j<ISRSTATBINS; j++) printfROM(" %u",St.lathist[j]);
+      printfROM("\n");
+    }
+  }
+}
+#if ISRLOAD
+void ShowCPULoad(void)
+  // Show the CPU load over the last second.  (the 'L' command)
+{
+  ISRLoad Ld;  byte i;
+  ISRLoadGet(&Ld);
+  for (i=0; i<ISRIDS; i++)
+    printfROM("%S %3u.%u%%\n",Names+i*7,Ld.isr[i]/10,Ld.isr[i]%10);
+  printfROM("Idle   %3u.%u%%\n",Ld.idle/10,Ld.idle%10);
+  printfROM("Main   %3u.%u%%\n",Ld.main/10,Ld.main%10);
+}
+#endif  // ISRLOAD
+#endif  // COMIF && ISRSTATS
+
+#if COMIF && FREQCTR && FCTRACE
+void ShowTrace(void)
+  // Dump the frequency counter events since the last dump.  (the 'D' command)
+{
+  static const char Names[] PROGMEM = 
+    "?      \0GateOpn\0GateCls\0Ovf    \0Mode   \0Ready  \0Read   \0PCLow  "
+    "\0PCHigh \0Period \0Arm    \0Timeout\0OvrRnge\0Absent \0Present\0Burst  "
+    "\0Preset ";
+  static FCTraceEvent Buf[FCTRACESIZE];
+  byte i,n;
+  n=FC.trace(Buf);
+  printfROM("%u events, %u lost.  Time is the system timer count (%u nS each)\n",
+            n,FC.tracelost(),(unsigned)(1000000000UL/SYSTIMERTICKSPERSEC));
+  for (i=0; i<n; i++)
+    printfROM("%5u %S %3u\n",Buf[i].time,
+              Names+((Buf[i].type<=FCEV_PRESET)?Buf[i].type:0)*8,Buf[i].data);
+}
+#endif  // COMIF && FREQCTR && FCTRACE
+
+#if COMIF && FREQCTR && FCBURST
+#define BURSTMAX  16              // most ext gates captured by the 'B' command
+static FCGate Burst[BURSTMAX];    // the captured gates
+static byte   BurstGates;         // number of gates asked for
+
+void ShowBurst(void)
+  // Show the ext gates captured since the 'B<n>' command.  (the 'B' command)
+{
+  byte i,n;
+  n=FC.captured();
+  printfROM("%u of %u gates captured.  Length is in timer ticks (%u nS each)\n",
+            n,BurstGates,(unsigned)(1000000000UL/SYSTIMERTICKSPERSEC));
+  for (i=0; i<n; i++) printfROM("%2u %10lu %10lu\n",i,Burst[i].count,Burst[i].len);
+}
+#endif  // COMIF && FREQCTR && FCBURST
+
 #if HASLCD
 #if FREQGEN
 void ShowGenFreq(void)
@@ -218,7 +313,7 @@ void ShowCtrMode(sbyte Mode)
   char St[17];
   Lcd.setCursor(0,1);     
   if (!Mode)  { Lcd.print("                "); return; }
-  if (((byte)Mode)<7) Lcd.print(" Gate: "); else Lcd.print(" #Avgs: ");
+  if (((byte)Mode)<7 || ((byte)Mode)>9) Lcd.print(" Gate: "); else Lcd.print(" #Avgs: ");
   switch (Mode)
   {
     case 1:  strcpy_P(St,PSTR("1 Sec"));  break;
@@ -230,6 +325,9 @@ void ShowCtrMode(sbyte Mode)
     case 7:  strcpy_P(St,PSTR("1   "));   break;
     case 8:  strcpy_P(St,PSTR("10  "));  break;
     case 9:  strcpy_P(St,PSTR("100 "));  break;
+    case 10: strcpy_P(St,PSTR("T 1S "));  break;
+    case 11: strcpy_P(St,PSTR("T10mS"));  break;
+    case 12: strcpy_P(St,PSTR("T.1S "));  break;
   }
   Lcd.print(St);  Lcd.print(" ("); Lcd.print((byte)Mode); Lcd.print(")  ");
 }
@@ -326,7 +424,7 @@ void loop()
 
 #if FREQCTR
     i=digitalRead(FCBUTTONUP);
-    if (!i && FcBtnUH && FCMode<9)
+    if (!i && FcBtnUH && FCMode<12)
     {
       // Go to next gate time (input to SetGateTime has indexes out of order)
       if (FCMode==1) FCMode=4; else if (FCMode==3) FCMode=1; else FCMode++; 
@@ -456,6 +554,14 @@ ReturnGate:     printfROM("Frequency counter gate set to %d\n", Gate);
               printfROM("Frequency is %s Hz\n", FC.read(InBuf,InBufPtr>1)); 
             else if (InBufPtr==2 && toupper(InBuf[1])=='S')
               printfROM("CountReady = %d\n",FC.available());
+#if FCCHANNEL2
+            else if (InBufPtr==2 && InBuf[1]=='2')
+            {
+              char St[16];
+              FC.read(St,1);    // (read2 is from the same gate as this)
+              printfROM("Frequency is %s Hz, %s Hz (D12)\n", St, FC.read2(InBuf)); 
+            }
+#endif
             else goto Invalid;
             break; 
           case 'R': 
@@ -464,6 +570,52 @@ ReturnGate:     printfROM("Frequency counter gate set to %d\n", Gate);
             printf_P((FCState)?PSTR("ON\n"):PSTR("OFF\n"));
             break;
 #endif          
+#if FREQCTR && FCBURST
+          case 'B': 
+            if (InBufPtr>1)
+            {
+              Val=strtol(InBuf+1,&last,10);
+              if ((last-InBuf)<(InBufPtr) || Val<1 || Val>BURSTMAX) goto Invalid;
+              if (!FC.arm(Burst,(byte)Val)) goto Invalid;
+              BurstGates=(byte)Val;
+              printfROM("Capturing the next %u ext gates\n",BurstGates);
+            }
+            else ShowBurst();
+            break;
+#endif
+#if FREQCTR && FCPRESET
+          case 'P': 
+            if (InBufPtr>1)
+            {
+              Val=strtol(InBuf+1,&last,10);
+              if ((last-InBuf)<(InBufPtr) || Val<0) goto Invalid;
+              FC.preset(Val,1);         // (auto reload)
+              if (Val) printfROM("Counting batches of %ld pulses\n",Val);
+              else printfROM("Preset counter off\n");
+            }
+            else printfROM("%lu batches done\n",FC.batches());
+            break;
+#endif
+#if FREQCTR && FCTRACE
+          case 'D': 
+            if (InBufPtr==1) ShowTrace();
+            else goto Invalid;
+            break;
+#endif
+#if ISRSTATS
+          case 'I': 
+            if (InBufPtr==1) ShowISRStats();
+            else if (InBufPtr==2 && toupper(InBuf[1])=='C') 
+              { ISRStatClear();  printfROM("ISR statistics cleared\n"); }
+            else goto Invalid;
+            break;
+#if ISRLOAD
+          case 'L': 
+            if (InBufPtr==1) ShowCPULoad();
+            else goto Invalid;
+            break;
+#endif
+#endif
           case '?':
             printfROM("Frequency Generator and Frequency Counter Test Module.\n");
             printfROM("Vers: " VERSION "        (c) Rick Groome 2021\n\n");
@@ -474,14 +626,33 @@ ReturnGate:     printfROM("Frequency counter gate set to %d\n", Gate);
             printfROM("G         Get currently set generator frequency.\n");
 #endif
 #if FREQCTR
-            printfROM("T[0..9]   Set frequency counter gate time.\n");
+            printfROM("T[0..12]  Set frequency counter gate time.\n");
             printfROM("          0=off, 1=1sec, 2=10mS, 3=100mS, 4=10S, 5=100S, 6=ext\n");
             printfROM("          7=Period mode, 8=Period(10 avg), 9=Period(100 avg)\n");
+            printfROM("          10=1sec, 11=10mS, 12=100mS timer gate (D5 to D9)\n");
             printfROM("T         Get currently set frequency counter gate time.\n");
             printfROM("F         Get last read frequency counter value.\n");
             printfROM("F1        Wait for and get next freq counter value.\n");
             printfROM("FS        Returns 0 if not ready, or 1 if new value available.\n");
+#if FCCHANNEL2
+            printfROM("F2        Wait for and get next value of both inputs (D6, D12).\n");
+#endif
             printfROM("R         Turns on/off auto read of frequency counter. (toggle)\n");
+#endif
+#if FREQCTR && FCBURST
+            printfROM("B[n]      Capture next n (1..16) ext gates / show them.\n");
+#endif
+#if FREQCTR && FCPRESET
+            printfROM("P[n]      Count batches of n pulses (P0 off) / show batches.\n");
+#endif
+#if FREQCTR && FCTRACE
+            printfROM("D         Dump frequency counter event trace.\n");
+#endif
+#if ISRSTATS
+            printfROM("I         Show ISR time statistics.  (IC clears them)\n");
+#if ISRLOAD
+            printfROM("L         Show CPU load over the last second.\n");
+#endif
 #endif
             printfROM("?         Show this help screen.\n");
             break;
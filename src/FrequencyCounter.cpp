@@ -58,11 +58,12 @@
   //   4= 10 Sec gate time 5= 100 Sec gate time, 6= Ext Gate (low going).
   //   7= Period mode (1 period), 8= Period mode (average 10 periods)
   //   9= Period mode (average 100 periods)
-  // GateTime values 6..9 are available only if compile option is enabled.
+  //   10= 1 Sec timer gate, 11= 10mS timer gate, 12= 100mS timer gate
+  // GateTime values 6..12 are available only if compile option is enabled.
   // Function returns the current gate time or -1 if error.     
   
   sbyte FrequencyCounter::mode(void) 
-  // Returns the current gate mode/time. (0..9)
+  // Returns the current gate mode/time. (0..12)
 
   char *FrequencyCounter::read(char *St,  bool Wait)
   // Reads the value of the frequency counter and returns a string of the 
@@ -114,7 +115,8 @@
   // This is normally done in the ISR of one of the timers in the micro. 
   
   While the basic user interface is via a class, only a single instance should 
-  be declared as this module uses specific hardware resources. 
+  be declared as this module uses specific hardware resources.  The second 
+  counter (FCCHANNEL2) is read from the same instance with read2. 
   
   Input to the frequency counter is on Arduino Digital pin 6 [PD7] for 
   Pro Micro (atmega32u4) and is assumed to be a low going train of pulses 
@@ -141,6 +143,31 @@
   is expanded to also use it for the gate timer for the frequency counter 
   function.   
   
+  On boards that do have the Timer1 clock input (Leonardo D12 [PD6]) Timer1 
+  can be used as the counter instead by defining 'FCCOUNTTIMER' as 1 and 
+  moving the system timer to Timer3 ('SYSTIMERNO' 3 in systimer.h).  Because 
+  Timer1 is a 16 bit timer, it only interrupts once every 65536 counts instead 
+  of every 256 counts (about 122 interrupts/sec at 8MHz instead of 31250), 
+  which leaves much more CPU time for everything else and reduces the gate 
+  jitter caused by these interrupts.  Everything else works the same. 
+  
+  The ATmega328P (Uno) and ATmega2560 (Mega) are supported too.  The only 
+  differences are the pins, which are picked by the part (the hardware 
+  backend section below), and the best timers to use: on the Uno the system 
+  timer moves to the 8 bit Timer2 (SYSTIMERNO 2) and the 16 bit Timer1 
+  counts the input on D5.  On the Mega the 16 bit Timer5 counts the input on 
+  D47 and the system timer stays on Timer1.  These are the defaults for those 
+  parts.  The timer gated modes (FCTIMERGATE) and the 64MHz time stamp 
+  (SYSTIMERPLLTS) are ATmega32U4 only.  The ISR time and CPU load 
+  measurements (ISRStats) and the trace work the same on all of them. 
+  
+  Or, with 'FCCHANNEL2', Timer1 counts a second input (D12) while Timer0 
+  counts the first.  Both counters are started and stopped together by the 
+  same gate (one right after the other, so the gate is the same length for 
+  both) and the two readings are from the same time.  read2 returns the 
+  second input's reading from the same gate as the last read.  The period 
+  modes, over range and presence detection only use the first input. 
+  
   Obviously, when using an alternate timer for the "system" timer function 
   and frequency counter gating function, the timer will not be available for 
   PWM functions or any other "built in" library functions that normally depend 
@@ -161,6 +188,14 @@
   set up a timer for the gate time and output it on a pin and then use a pin 
   change or external interrupt as the gate timer source.  (Pin change and 
   external interrupts have a higher priority than the USB interrupts).
+  To reduce this problem, when "SYSTIMERGATE" is defined as non-zero in 
+  systimer.h, the gate edges are timed by compare unit B of the system timer 
+  instead of by the 1mS timer interrupt.  The compare B ISR reads the timer 
+  on entry and waits for a fixed point after the compare match 
+  (SYSTIMERGATESYNC) before opening/closing the gate, so each gate edge is 
+  the same number of CPU cycles after the compare match.  If the ISR was held 
+  off longer than that, the extra time is measured and the count is corrected 
+  for the longer gate when it is read. 
   Also note that at frequencies above about 2MHz the count returned might be 
   short a count or two.  This is because of the necessity of clearing the 
   counter, turning it off and then back on which takes a couple of CPU cycles. 
@@ -174,11 +209,29 @@
   pin turns on the gate, and when hi the gate is turned off.  Including the 
   external gate function is optional.
   
+  The pin change ISR reads the pins and calls the attached function (see 
+  PCInterrupt::attach) before the counter is started or stopped, so the gate edge latency depends on the 
+  code path.  If 'FCEXTGATEINT' is 0..3, the gate input is the external 
+  interrupt pin INT0..INT3 instead (PCInterrupt.cpp is not needed).  Its 
+  hand coded ISR starts or stops the counter a fixed number of cycles after 
+  the edge (the same for both edges) and then the C code does the rest.  The 
+  interrupt is switched between the falling (open) and rising (close) edge 
+  so only the expected edge interrupts. 
+  
   Using the external gate function and another timer set up to work 
   autonomously and then output its signal on some other pin, and then 
   connecting this pin to the Ext Gate input might be a way to get around the 
   USB problem  mentioned above that might affect the count, because the 
   external gate inputs are all higher in priority than the USB interrupt are.
+  This is built in as the "timer gated" modes (10=1S, 11=10mS, 12=100mS) 
+  when 'FCTIMERGATE' is defined as non-zero.  In these modes Timer3 is set up 
+  to output the gate signal on Arduino Digital pin 5 [PC6] (low for exactly 
+  the gate time, then high for 'FCTGDEAD' mS) and this pin must be connected 
+  to the ext gate pin (Digital 9).  Because the gate time is known exactly, 
+  the value read is scaled to Hz just like modes 1..3.  If Timer3 is the 
+  system timer, then Timer1 is used instead and its output is Digital pin 9 
+  [PB5] itself, so no connection is needed.  Timer3 (or Timer1) PWM functions 
+  are not available while in a timer gated mode. 
 
   With the Arduino Pro Micro modules available during development the system 
   was able to reliably count to frequencies of up to about 8MHz (1/2 of 
@@ -214,11 +267,35 @@ Revision log:
     Initial implementation
   1.0.1    6-20-21   REG   
     Reworked to put compile options in header file
+  1.1.0    10-16-26  contrib
+    Gate edges timed by compare unit B of the system timer (SYSTIMERGATE)
+    Added timer gated modes (gate from Timer3 output via ext gate input)
+    Added Timer1 counting option (FCCOUNTTIMER)
+    Added hand coded counter overflow ISR (FCFASTOVF)
+    Works with a tickless system timer (SYSTIMERTICKLESS)
+    Uses its own timer on the system timer wheel (SYSTIMERWHEEL)
+    Period measure uses system timer ticks (up to 62.5nS) instead of micros
+    Period measure can use the 64MHz Timer4 time stamp (SYSTIMERPLLTS)
+    ISR time measurement hooks (ISRStats module)
+    Wait in read() counted as idle by the CPU load meter (ISRLOAD)
+    Event trace buffer (FCTRACE)
+    Counter interrupt budget / over range detection (FCOVFBUDGET)
+    Input signal presence detection and idle (FCPRESENCE)
+    Ext gate on an external interrupt pin INT0..INT3 (FCEXTGATEINT)
+    Ext gate length measured, mode 6 reads as a frequency (FCEXTTIME)
+    Burst capture of K ext gates (arm/captured, FCBURST)
+    Ext gate pin uses its own attached function (PCInterrupt::attach) 
+    instead of PCChangeIntFunc, which is left for the user
+    Second counter on Timer1 gated with the Timer0 counter (FCCHANNEL2)
+    ATmega328P (Timer1 counter, D5) and ATmega2560 (Timer5 counter, D47)
+    Period edges counted with the counter in CTC mode, no reload (FCPRDCTC)
+    Preset (batch) counter with a hardware compare output (preset, FCPRESET)
 */
 
 #include <arduino.h>
 #include "FrequencyCounter.h"
 #include "systimer.h"           // access to SysTimerIntFunc
+#include "ISRStats.h"           // ISR time measurement (if ISRSTATS)
 
 /******************************************************************************/
 /*                        User configurable options                           */
@@ -229,6 +306,37 @@ Revision log:
 #define FCINCLUDESYSTIMERLINK 1             // define as non-zero to take over function
 #endif
 
+// Use the hand coded (faster) counter overflow ISR?
+#ifndef FCFASTOVF
+#define FCFASTOVF             0             // 1= use hand coded overflow ISR
+#endif
+#ifndef FCFASTOVFSCOPE
+#define FCFASTOVFSCOPE        -1            // -1= off, 0..7= PORTB bit pulsed
+#endif
+
+// Max counter interrupts per second before the input is over range
+#ifndef FCOVFBUDGET
+#define FCOVFBUDGET           0             // interrupts/sec (0= no limit)
+#endif
+#ifndef FCOVERRANGE
+#define FCOVERRANGE           0xFFFFFFFFUL  // read() value when over range
+#endif
+
+// mS with no input edges before the counter goes idle
+#ifndef FCPRESENCE
+#define FCPRESENCE            0             // mS (0= always present)
+#endif
+
+// Timer used to count the input (0 or 1).  Timer1 requires SYSTIMERNO 3.
+#ifndef FCCOUNTTIMER
+#define FCCOUNTTIMER          0             // 0= Timer0 (D6), 1= Timer1 (D12)
+#endif
+
+// Count a second input on Timer1 (T1 pin) with the same gate?  (read2)
+#ifndef FCCHANNEL2
+#define FCCHANNEL2            0             // 1= second counter on Timer1
+#endif
+
 // Allow Ext Gate mode?       (adds 244 flash bytes )
 #ifndef FCEXTERN
 #define FCEXTERN              1             // 1= ext gate mode enabled
@@ -236,7 +344,22 @@ Revision log:
 
 // Arduino pin number to use for external gate
 #ifndef FCEXTGATEMSK
-#define FCEXTGATEMSK          PCINTMASK9    // PB5 isr index (Arduino Digital 9)
+#define FCEXTGATEMSK          PCINTMASK9    // PB5 isr index (Digital 9, Uno D13, Mega D11)
+#endif
+
+// External interrupt to use for the ext gate instead (-1= pin change)
+#ifndef FCEXTGATEINT
+#define FCEXTGATEINT          -1            // -1= pin change, 0..3= INT0..3
+#endif
+
+// Measure the ext gate length (mode 6 reads as frequency)?
+#ifndef FCEXTTIME
+#define FCEXTTIME             1             // 1= measure ext gate length
+#endif
+
+// Allow burst capture of ext gates?
+#ifndef FCBURST
+#define FCBURST               1             // 1= arm/captured available
 #endif
 
 // Allow period measure mode? (adds 1030 flash bytes)
@@ -244,6 +367,19 @@ Revision log:
 #define FCPERIOD              1             // 1= Period measure mode enabled
 #endif
 
+// Count the period edges with the counter in CTC mode?
+#ifndef FCPRDCTC
+#define FCPRDCTC              1             // 1= period edges counted in CTC mode
+#endif
+
+// Allow the preset (batch) counter?  Toggle the OCxA pin?
+#ifndef FCPRESET
+#define FCPRESET              0             // 1= preset counter available
+#endif
+#ifndef FCPRESETOUT
+#define FCPRESETOUT           1             // 1= toggle the OCxA pin
+#endif
+
 // For period measure it must occur within this many mS
 #ifndef PERIODTIMOUT
 #define PERIODTIMOUT          5000          
@@ -257,6 +393,17 @@ Revision log:
 // Enable this for debug messages.
 //#define FRQCTRDEBUG           1             // For debug... show debug messages. 
 
+// Keep a trace of the counter events in RAM?
+#ifndef FCTRACE
+#define FCTRACE               0             // 1= trace enabled
+#endif
+#ifndef FCTRACESIZE
+#define FCTRACESIZE           64            // events kept (power of 2, max 128)
+#endif
+#ifndef FCTRACEOVF
+#define FCTRACEOVF            0             // 1= trace overflows too
+#endif
+
 
 /******************************************************************************/
 /*                                                                            */
@@ -265,26 +412,175 @@ Revision log:
 /******************************************************************************/
 
 #if FCEXTERN
-#include "PCInterrupt.h"  // access to PCChangeIntFunc (for ext gate)
+#include "PCInterrupt.h"  // access to PCH.attach (for ext gate)
+#endif
+
+// Hardware backend.  The counter input pins (Tn), compare output pins 
+// (OCnA) and ext interrupt pins (INTn) for each part.  Everything else is 
+// the same on all of them (the timers have the same registers, just a 
+// different number). 
+#if defined(__AVR_ATmega32U4__) || defined(__AVR_ATmega16U4__)
+#define FCT0PIN               6             // T0 input is D6 [PD7]
+#define FCT1PIN               12            // T1 input is D12 [PD6] (Leonardo)
+#define FCOC0APIN             11            // OC0A is D11 [PB7]
+#define FCOC1APIN             9             // OC1A is D9 [PB5]
+#define FCINTPIN(n)           (((n)==0)?3:((n)==1)?2:((n)==2)?0:1)  // INTn pin
+#define FCINTBIT(n)           (n)           // INTn is PDn
+#define FCINTS                4             // INT0..INT3
+#elif defined(__AVR_ATmega328P__) || defined(__AVR_ATmega168__)
+#define FCT0PIN               4             // T0 input is D4 [PD4]
+#define FCT1PIN               5             // T1 input is D5 [PD5]
+#define FCOC0APIN             6             // OC0A is D6 [PD6]
+#define FCOC1APIN             9             // OC1A is D9 [PB1]
+#define FCINTPIN(n)           ((n)+2)       // INT0 is D2, INT1 is D3
+#define FCINTBIT(n)           ((n)+2)       // INTn is PD(n+2)
+#define FCINTS                2             // INT0..INT1
+#elif defined(__AVR_ATmega2560__) || defined(__AVR_ATmega1280__)
+#define FCT0PIN               38            // T0 input is D38 [PD7]
+#define FCT5PIN               47            // T5 input is D47 [PL2]
+#define FCOC0APIN             13            // OC0A is D13 [PB7]
+#define FCOC5APIN             46            // OC5A is D46 [PL3]
+#define FCINTPIN(n)           (21-(n))      // INT0..3 are D21..D18
+#define FCINTBIT(n)           (n)           // INTn is PDn
+#define FCINTS                4             // INT0..INT3
+#else
+#error "This module (FrequencyCounter.cpp) supports the ATMega32U4/16U4, 328P and 2560"
+#endif
+
+// Counting timer is 'c'.  (Timer0, or Timer1/Timer5).  Timer1 and Timer5 are 
+// 16 bit timers so they overflow (and interrupt) 256 times less often.
+#if FCCOUNTTIMER==SYSTIMERNO
+#error "The counter (FCCOUNTTIMER) can't be the system timer (SYSTIMERNO)"
+#endif
+#if FCCOUNTTIMER==1 && defined(FCT1PIN)
+#if FCTIMERGATE
+#error "FCTIMERGATE can't be used with FCCOUNTTIMER 1 (no 16 bit timer left for the gate)"
+#endif
+#define FCINPIN               FCT1PIN
+#define FCOUTPIN              FCOC1APIN
+#elif FCCOUNTTIMER==5 && defined(FCT5PIN)
+#define FCINPIN               FCT5PIN
+#define FCOUTPIN              FCOC5APIN
+#elif FCCOUNTTIMER==0
+#define FCINPIN               FCT0PIN
+#define FCOUTPIN              FCOC0APIN
+#else
+#error "This part has no input pin for the FCCOUNTTIMER timer"
+#endif
+#if FCCOUNTTIMER
+#define FCOVFSHIFT            16            // bits in the counter register
+#define FCCNT                 unsigned int  // type of the counter register
+#else
+#define FCOVFSHIFT            8             // bits in the counter register
+#define FCCNT                 byte          // type of the counter register
+#endif
+#define TCNTc                 PASTETOKENS(TCNT,FCCOUNTTIMER)
+#define TCCRcA                PASTETOKENS(PASTETOKENS(TCCR,FCCOUNTTIMER),A) 
+#define TCCRcB                PASTETOKENS(PASTETOKENS(TCCR,FCCOUNTTIMER),B) 
+#define TIMSKc                PASTETOKENS(TIMSK,FCCOUNTTIMER)
+#define TOIEc                 PASTETOKENS(TOIE,FCCOUNTTIMER)       
+#define TIFRc                 PASTETOKENS(TIFR,FCCOUNTTIMER)
+#define TOVc                  PASTETOKENS(TOV,FCCOUNTTIMER)
+#define TIMERc_OVF_vect       PASTETOKENS(PASTETOKENS(TIMER,FCCOUNTTIMER),_OVF_vect) 
+
+// CTC mode (period modes with FCPRDCTC, preset mode): the counter clears 
+// itself on the edge that matches OCRcA and the compare A ISR runs.  The 
+// compare output (OCcA pin) can be set/cleared/toggled on the match. 
+#define OCRcA                 PASTETOKENS(PASTETOKENS(OCR,FCCOUNTTIMER),A)
+#define OCIEcA                PASTETOKENS(PASTETOKENS(OCIE,FCCOUNTTIMER),A)
+#define OCFcA                 PASTETOKENS(PASTETOKENS(OCF,FCCOUNTTIMER),A)
+#define OCRcB                 PASTETOKENS(PASTETOKENS(OCR,FCCOUNTTIMER),B)
+#define OCIEcB                PASTETOKENS(PASTETOKENS(OCIE,FCCOUNTTIMER),B)
+#define OCFcB                 PASTETOKENS(PASTETOKENS(OCF,FCCOUNTTIMER),B)
+#define TIMERc_COMPB_vect     PASTETOKENS(PASTETOKENS(TIMER,FCCOUNTTIMER),_COMPB_vect) 
+#define COMcA0                PASTETOKENS(PASTETOKENS(COM,FCCOUNTTIMER),A0)
+#define COMcA1                PASTETOKENS(PASTETOKENS(COM,FCCOUNTTIMER),A1)
+#define FOCcA                 PASTETOKENS(PASTETOKENS(FOC,FCCOUNTTIMER),A)
+#define TIMERc_COMPA_vect     PASTETOKENS(PASTETOKENS(TIMER,FCCOUNTTIMER),_COMPA_vect) 
+#if FCCOUNTTIMER
+#define FCCTCA                0             // CTC is WGMn2 in TCCRnB (mode 4)
+#define FCCTCB                (1<<PASTETOKENS(PASTETOKENS(WGM,FCCOUNTTIMER),2))
+#define FCFORCEOC()           PASTETOKENS(PASTETOKENS(TCCR,FCCOUNTTIMER),C)=(1<<FOCcA)
+#else
+#define FCCTCA                (1<<WGM01)    // CTC is WGM01 in TCCR0A (mode 2)
+#define FCCTCB                0
+#define FCFORCEOC()           TCCR0B=(1<<FOC0A)   // (timer stopped)
+#endif
+
+// Period modes in CTC mode: the counter clears itself after PrdCnt edges 
+// (OCRcA=PrdCnt-1) and the compare A ISR takes the time stamp.  FCPRDIE/IF 
+// are the period mode interrupt enable/flag bits (overflow if not CTC). 
+#if FCPERIOD && FCPRDCTC
+#define FCPRDIE               (1<<OCIEcA)
+#define FCPRDIF               (1<<OCFcA)
+#else
+#define FCPRDIE               (1<<TOIEc)
+#define FCPRDIF               (1<<TOVc)
+#endif
+
+// Allow timer gated modes?  (uses the ext gate input)
+#ifndef FCTIMERGATE
+#define FCTIMERGATE           1             // 1= timer gated modes enabled
+#endif
+
+// mS between gates in the timer gated modes (gate off time)
+#ifndef FCTGDEAD
+#define FCTGDEAD              1            
+#endif
+
+#if FCTIMERGATE && !FCEXTERN
+#error "FCTIMERGATE requires FCEXTERN (the timer gate is read on the ext gate input)"
+#endif
+#if FCTIMERGATE && !(defined(__AVR_ATmega32U4__) || defined(__AVR_ATmega16U4__))
+#error "FCTIMERGATE is only on the ATmega32U4 (Timer3/Timer1 OCxA pin)"
 #endif
 
-#if !(defined(__AVR_ATmega32U4__) || defined(__AVR_ATmega16U4__))
-#error "This module (FrequencyCounter.cpp) only supports ATMega32U4/16U4"
+// Second counting timer is 'd' (Timer1).  It is started and stopped right 
+// after the first one by the same gate code.
+#if FCCHANNEL2
+#if FCCOUNTTIMER!=0 || SYSTIMERNO==1 || FCTIMERGATE || !defined(FCT1PIN)
+#error "FCCHANNEL2 requires FCCOUNTTIMER 0, SYSTIMERNO not 1, FCTIMERGATE 0 and a T1 pin"
+#endif
+#define FCINPIN2              FCT1PIN       // T1 input (D12 Leonardo, D5 Uno)
+#define TCNTd                 TCNT1
+#define TCCRdA                TCCR1A
+#define TCCRdB                TCCR1B
+#define TIMSKd                TIMSK1
+#define TOIEd                 TOIE1
+#define TIFRd                 TIFR1
+#define TOVd                  TOV1
+#define TIMERd_OVF_vect       TIMER1_OVF_vect
 #endif
 
+// Note: The timer gated modes are always the last modes (after FCTGNO)
 #if FCPERIOD && FCEXTERN
 #define FCEXTNO               6             // this is the value for ext clock mode
 #define FCPRDNO               7             // this is the value for period mode
-#define FCMODEMAX             9             // this is the max value of mode  
+#define FCTGNO                10            // this is the value for timer gated mode
 #elif FCEXTERN
 #define FCEXTNO               6             // this is the value for ext clock mode
-#define FCMODEMAX             6             // this is the max value of mode  
+#define FCTGNO                7             // this is the value for timer gated mode
 #elif FCPERIOD
 #define FCPRDNO               6             // this is the value for period mode
 #define FCMODEMAX             8             // this is the max value of mode  
 #else
 #define FCMODEMAX             5             // this is the max value of mode  
 #endif
+#if FCEXTERN && FCTIMERGATE
+#define FCMODEMAX             (FCTGNO+2)    // this is the max value of mode  
+#elif FCEXTERN
+#define FCMODEMAX             (FCTGNO-1)    // this is the max value of mode  
+#endif
+
+// True if mode 'm' is one of the 3 period modes / timer gated modes / 
+// a mode that uses the ext gate input
+#define FCISPRD(m)            (((byte)((m)-FCPRDNO))<3)
+#if FCTIMERGATE
+#define FCISTG(m)             (((byte)((m)-FCTGNO))<3)
+#define FCISEXT(m)            ((m)==FCEXTNO || FCISTG(m))
+#else
+#define FCISEXT(m)            ((m)==FCEXTNO)
+#endif
 
 #if FRQCTRDEBUG
 #define printfROM(fmt, ...)       printf_P(PSTR(fmt),##__VA_ARGS__)
@@ -303,22 +599,158 @@ static unsigned int           fcprescalInit = 0;  // The gate time (prescaler) i
                                                   //  (10's of mS) (0,1,10,100,1000)
 static sbyte                  fcGateTime=0;       // saved selected gate time
 
+// Time base for the period measure and the ext gate length.  The system 
+// timer ticks (4uS, 0.5uS or 62.5nS depending on TIMERPSVALUE) if we have it, 
+// else micros().  Or the 64MHz Timer4 time stamp (15.6nS) if SYSTIMERPLLTS.
+#if SYSTIMERINCLUDESDELAY && SYSTIMERPLLTS
+#define FCPRDTIME()           pllticks32()
+#define FCPRDTPS              SYSTIMERPLLTPS      // FCPRDTIME counts per second
+#elif SYSTIMERINCLUDESDELAY
+#define FCPRDTIME()           ticks32()
+#define FCPRDTPS              SYSTIMERTICKSPERSEC // FCPRDTIME counts per second
+#else
+#define FCPRDTIME()           micros()
+#define FCPRDTPS              1000000L
+#endif
+
 #if FCPERIOD
 static byte                   PrdCnt=0;           // Averaging for period measure
+// Shortest period (in FCPRDTIME counts) that fits in the result (freq*1E5)
+#define FCPRDMIN              (FCPRDTPS/42949+1)
 #else
 #define PrdCnt                0                   // dummy value if if no period measure
 #endif
 
+// Use compare unit B of the system timer to time the gate edges? 
+#if FCINCLUDESYSTIMERLINK && SYSTIMERGATE
+#define FCHWGATE              1
+static unsigned int           fcGateLate=0;       // latency of last gate edge (timer ticks)
+volatile static int           fcGateAdj=0;        // last gate length - nominal (timer ticks)
+#endif
+
+#define FCTIME                10                  // FreqCtrGateISR rate (10mS)
+
+#if FCCHANNEL2
+volatile static unsigned long fcResult2 = 0;      // second counter's value (like fcResult)
+volatile static unsigned long fcOVF2 = 0;         // upper bits of the second counter
+static unsigned long          fcRead2 = 0;        // fcResult2 when the counter was read
+static unsigned long          fcRead2Len = 0;     // fcExtLen then (FCEXTTIME)
+#endif
+
+#if FCEXTERN && FCEXTTIME
+static unsigned long          fcExtOpen=0;        // time the ext gate opened (FCPRDTIME)
+volatile static unsigned long fcExtLen=0;         // length of the last ext gate (FCPRDTIME counts)
+
+// The longest ext gate that can be measured is one FCPRDTIME wrap (2^32 
+// counts): 67S with SYSTIMERPLLTS, 268S/35.8min/4.8hrs with 62.5nS/0.5uS/4uS 
+// system timer ticks, or 71.6min with micros().  A longer gate reads too high.
+
+static char *FreqCtrExtStr(char *St, unsigned long long Cnt, unsigned long Len)
+  // Put Cnt/Len (the count over the ext gate length) in St as the frequency 
+  // in Hz with 3 decimals.  The whole Hz are divided out first and the 
+  // remainder scaled for the fraction so nothing overflows 64 bits. 
+{
+  unsigned long long n=Cnt*FCPRDTPS;     // < 2^61 (Cnt < 2^35, FCPRDTPS < 2^26)
+  unsigned long long Hz=n/Len;
+  unsigned int mHz=(unsigned int)(((n%Len)*1000)/Len);
+  if (Hz>0xFFFFFFFFULL) strcpy_P(St,PSTR("OVER"));
+  else sprintf_P(St,PSTR("%lu.%03u"),(unsigned long)Hz,mHz);
+  return St;
+}
+#endif
+
+#if FCPRESENCE
+// The whole counter value (it only goes up between gates, so any input edge 
+// changes it).  Reset with the counter by FreqCtrLatch. 
+#define FCPRESCOUNT()         ((fcOVF << FCOVFSHIFT) + (unsigned long)TCNTc)
+static unsigned long          fcPresLast=0;       // FCPRESCOUNT at last check
+#endif
+
+#if FCTRACE
+#if !SYSTIMERINCLUDESDELAY
+#error "FCTRACE time stamps use the system timer count (needs SYSTIMERINCLUDESDELAY)"
+#endif
+#if FCTRACESIZE>128 || (FCTRACESIZE & (FCTRACESIZE-1))
+#error "FCTRACESIZE must be a power of 2 no bigger than 128"
+#endif
+static FCTraceEvent           fcTrace[FCTRACESIZE];  // the trace (ring buffer)
+volatile static byte          fcTraceHead=0;      // events written (mod 256)
+volatile static byte          fcTraceTail=0;      // oldest event not read yet
+volatile static unsigned int  fcTraceLost=0;      // events written over (max 65535)
+
+static inline void FreqCtrTrace(byte Type, byte Data)
+  // Add an event to the trace.  (Call with interrupts off)  If the trace is 
+  // full the oldest event is written over and counted as lost, the ISR never 
+  // waits for the reader.  (Head-Tail never passes FCTRACESIZE)
+{
+  byte h=fcTraceHead;
+  FCTraceEvent *e = &fcTrace[h & (FCTRACESIZE-1)];
+  if ((byte)(h-fcTraceTail)>=FCTRACESIZE)   // full.  Drop the oldest 
+    { fcTraceTail++;  if (fcTraceLost!=0xFFFF) fcTraceLost++; }
+  e->type=Type;  e->data=Data;  e->time=SYSTIMERTCNT;
+  fcTraceHead=h+1;
+}
+// FCTRACEEV from ISRs, FCTRACEEVM from mainline code (interrupts on)
+#define FCTRACEEV(t,d)        FreqCtrTrace(t,d)
+#define FCTRACEEVM(t,d)       do { uint8_t svSREG=SREG; cli(); \
+                                   FreqCtrTrace(t,d);  SREG=svSREG; } while (0)
+#else
+#define FCTRACEEV(t,d)
+#define FCTRACEEVM(t,d)
+#endif
 
-#if FCINCLUDESYSTIMERLINK
+#if FCOVFBUDGET
+#if SYSTIMERTICKLESS || !FCINCLUDESYSTIMERLINK
+#error "FCOVFBUDGET needs FreqCtrGateISR called every 10mS (not SYSTIMERTICKLESS)"
+#endif
+#define FCOVFMAX              (FCOVFBUDGET/100)   // max counter interrupts per 10mS
+#define FCOVRPROBE            10                  // 10mS's between retries when over range
+static byte                   fcOverRange=0;      // 0=ok, 1=retrying, >1=over range
+static unsigned long          fcOVFLast=0;        // fcOVF at the last check
+#if FCPERIOD
+volatile static unsigned int  fcPrdEdges=0;       // period interrupts since last check
+// The counter interrupt (enable/flag bit) for the current mode
+#define FCCTRIE               (FCISPRD(fcGateTime) ? FCPRDIE : (1 << TOIEc))
+#define FCCTRIF               (FCISPRD(fcGateTime) ? FCPRDIF : (1 << TOVc))
+#else
+#define FCCTRIE               (1 << TOIEc)
+#define FCCTRIF               (1 << TOVc)
+#endif
+#endif
+
+
+#if FCINCLUDESYSTIMERLINK && SYSTIMERWHEEL
+// With the system timer wheel, FreqCtrGateISR is called by its own timer and 
+// SysTimerIntFunc is left free for the user. 
+static SysTimerNode fcGateNode;
+#elif FCINCLUDESYSTIMERLINK
 extern "C" void SysTimerIntFunc(void) 
   // This function is called by the system timer interrupt routine when
   // the timer times out each millisecond.  This timing is used to call the 
   // frequency counter gating function "FreqCtrGateISR" every 10mS.  
   // If this function is defined, it replaces the "weak" definition in the
   // systimer module. 
+  // With a tickless system timer (SYSTIMERTICKLESS) this is only called when 
+  // asked for, so ask to be called again when the gate time (or period 
+  // timeout) ends and skip the 10mS calls in between. 
 { 
-#define FCTIME   10             // 10mS
+#if SYSTIMERTICKLESS
+  if (fcprescaler)                      // if counter on (and not ext gate)
+  {
+#if FCPERIOD
+    // Period edges don't move the deadline, so only time out if the last 
+    // edge (fcOVF) is a whole timeout ago.  Else wait out the rest of it. 
+    if (FCISPRD(fcGateTime) && fcOVF)
+    {
+      unsigned long ms=(FCPRDTIME()-fcOVF)/(FCPRDTPS/1000);  // since last edge
+      unsigned long to=(unsigned long)fcprescalInit*FCTIME;
+      if (ms<to) { SysTimerNext(to-ms);  return; }
+    }
+#endif
+    fcprescaler=1;  FreqCtrGateISR();   // gate time is up
+    if (fcprescaler) SysTimerNext((unsigned long)fcprescaler*FCTIME);
+  }
+#else
   static byte fcprescale = FCTIME;
   // Do frequency counter gate function every FCTIME mS (10 mS)
   if (!--fcprescale)  
@@ -332,74 +764,721 @@ extern "C" void SysTimerIntFunc(void)
   static unsigned int dbgPS = LED2TIME; 
   if (!--dbgPS) { dbgPS=LED2TIME;  digitalWrite(LED2, !digitalRead(LED2)); } 
 #endif
+#endif  // SYSTIMERTICKLESS
 }
 #endif
 
 
-#if FCEXTERN
-extern "C" void PCChangeIntFunc(byte Changes[])
+#if FCEXTERN && FCBURST
+static FCGate                 *fcBurstBuf;        // where the captured gates go
+static byte                   fcBurstMax;         // number of gates to capture
+volatile static byte          fcBurstN=0;         // number captured so far
+volatile static byte          fcBurstState=0;     // 0=off, 1=armed, 2=capturing
+
+// Same as SysTimerIntFunc... If you define 
+//   extern "C" void FreqCtrBurstFunc(byte Gates) { <some code> }
+// then that function will be called when a burst capture is done.
+extern "C" void __FreqCtrBurstEmpty(byte Gates __attribute__((unused))) { }
+extern "C" void FreqCtrBurstFunc(byte Gates) __attribute__ ((weak, alias("__FreqCtrBurstEmpty")));
+
+static inline void FreqCtrBurstClose(void)
+  // A full ext gate closed (fcResult and fcExtLen are set).  Save it if 
+  // capturing, and stop after the last one. 
+{
+  FCGate *g;
+  if (fcBurstState!=2) return;
+  g=&fcBurstBuf[fcBurstN];
+  g->count=fcResult;  
+#if FCEXTTIME
+  g->len=fcExtLen;
+#else
+  g->len=0;
+#endif
+  if (++fcBurstN>=fcBurstMax) 
+  { 
+    fcBurstState=0;  
+    FCTRACEEV(FCEV_BURST,fcBurstN);  FreqCtrBurstFunc(fcBurstN); 
+  }
+}
+// An ext gate opened.  If armed, the capture starts with this gate.
+#define FCBURSTOPEN()         if (fcBurstState==1) fcBurstState=2
+#define FCBURSTCLOSE()        FreqCtrBurstClose()
+#else
+#define FCBURSTOPEN()
+#define FCBURSTCLOSE()
+#endif
+
+
+#if FCEXTERN && FCEXTGATEINT<0
+static void FreqCtrExtGatePC(byte Rising)
   // If the external gate time transitioned, start or stop the count
-  // This function is normally called via the pin change or external interrupt.
-  // Changes is an array[2] of byte that has bits set for each pin that changed 
-  // state.  Changes[0]=bits that just went low, Changes[1]=bits that just went high
-  // If this function is defined, it replaces the "weak" definition in the
-  // PCInterrupt module. 
+  // This function is called by the pin change or external interrupt when the 
+  // ext gate pin changes.  (Attached to FCEXTGATEMSK by mode, so the 
+  // PCChangeIntFunc hook is left free for the user) 
+  // 'Rising' is 0 if the pin just went low, 1 if it just went high. 
 {  
   byte svTCCR;
 
-  if (fcGateTime==FCEXTNO) 
+  FCTRACEEV(Rising?FCEV_PCHIGH:FCEV_PCLOW,FCEXTGATEMSK);
+  if (FCISEXT(fcGateTime))            // ext gate or timer gated mode 
   {
-    if (Changes[0]&FCEXTGATEMSK)       // if PinX went low
+    if (!Rising)                       // if PinX went low
     {
       // Start the counting 
       // ext clock--falling edge, reset overflow counter 
-      TCNT0=0; TCCR0B=6; fcOVF=0; 
-      Changes[0]&=~FCEXTGATEMSK;       // reset the changes bit
+#if FCCHANNEL2
+      TCNTc=0; TCNTd=0; TCCRcB=6; TCCRdB=6; fcOVF=0; fcOVF2=0; 
+#else
+      TCNTc=0; TCCRcB=6; fcOVF=0; 
+#endif
+#if FCEXTTIME
+      fcExtOpen=FCPRDTIME();          // time the gate opened
+#endif
+      FCBURSTOPEN();
+      FCTRACEEV(FCEV_GATEOPEN,0);
     }
-    if (Changes[1]&FCEXTGATEMSK)       // if PinX went hi
+    else                               // if PinX went hi
     {
       // finish the counting and move the results to fcResult
-      svTCCR=TCCR0B; TCCR0B=0; 
-      fcResult = (fcOVF << 8) + (unsigned long) TCNT0;  
+      svTCCR=TCCRcB; TCCRcB=0; 
+#if FCCHANNEL2
+      TCCRdB=0; 
+      if (TIFRd & (1<<TOVd)) { fcOVF2++;  TIFRd = (1<<TOVd); }
+      fcResult2 = (fcOVF2 << 16) + (unsigned long) TCNTd;  fcOVF2=0;
+#endif
+#if FCEXTTIME
+      fcExtLen=FCPRDTIME()-fcExtOpen;  // gate length 
+#endif
+      fcResult = (fcOVF << FCOVFSHIFT) + (unsigned long) TCNTc;  
       fcOVF=0; // reset overflow counter
-      // Note: We use TCCR0B<>0 to indicate it's an 'active' cycle 
+#if FCOVFBUDGET
+      if (fcOverRange) fcResult=FCOVERRANGE;   // (overflows weren't counted)
+#endif
+      FCTRACEEV(FCEV_GATECLOSE,fcResult);
+      // Note: We use TCCRcB<>0 to indicate it's an 'active' cycle 
       //       (a full gate period) (not the first gate cycle after we turned it on)
-      if (svTCCR) _FreqCtrReady=1;
-      Changes[1]=~FCEXTGATEMSK;        // reset the changes bit
+      if (svTCCR) 
+        { _FreqCtrReady=1;  FCTRACEEV(FCEV_READY,fcResult);  FCBURSTCLOSE(); }
     }
   } 
 }
 #endif
 
 
-ISR(TIMER0_OVF_vect) {
-  // Frequency counter counting interrupt service routine. 
-  // Increment the overflow counter when we run out of counts in the hardware
-  // register (TCNT0). This happens every 256 counts.  (Freq counter mode)
+#if FCEXTERN && FCEXTGATEINT>=0
+// Ext gate on external interrupt INTn (PD0..PD3)
+#if FCEXTGATEINT>=FCINTS
+#error "FCEXTGATEINT must be -1 (pin change) or 0..3 (INT0..INT3, INT0..INT1 on the 328P)"
+#endif
+#define FCEXTGATEPIN          FCINTPIN(FCEXTGATEINT)  // Arduino pin number
+#define FCEXTGATEBIT          FCINTBIT(FCEXTGATEINT)  // bit in PIND
+#define INTx                  PASTETOKENS(INT,FCEXTGATEINT)
+#define INTFx                 PASTETOKENS(INTF,FCEXTGATEINT)
+#define ISCx0                 PASTETOKENS(PASTETOKENS(ISC,FCEXTGATEINT),0)
+#define ISCx1                 PASTETOKENS(PASTETOKENS(ISC,FCEXTGATEINT),1)
+#define INTx_vect             PASTETOKENS(PASTETOKENS(INT,FCEXTGATEINT),_vect)
+static byte                   fcGateOpen=0;       // gate opened since ext gate on
+
+static void FreqCtrExtGateEdge(byte Rising)
+  // Set INTn to interrupt on the rising (gate close) or falling (gate open) 
+  // edge.  (Changing the edge can set the interrupt flag, so clear it)
+{
+  EIMSK &= ~(1<<INTx);
+  if (Rising) EICRA |= (1<<ISCx1)|(1<<ISCx0);
+  else      { EICRA |= (1<<ISCx1);  EICRA &= ~(1<<ISCx0); }
+  EIFR = (1<<INTFx);  EIMSK |= (1<<INTx);
+}
+
+
+static void FreqCtrExtGate(byte On)
+  // Turn the ext gate interrupt on (wait for the gate to open) or off.
+{
+  if (On) 
+  { 
+    pinMode(FCEXTGATEPIN,INPUT_PULLUP);  fcGateOpen=0;  
+    FreqCtrExtGateEdge(0);
+  }
+  else EIMSK &= ~(1<<INTx);
+}
+
+
+ISR(INTx_vect, ISR_NAKED) {
+  // Ext gate edge.  Start (pin low) or stop (pin high) the counter first 
+  // thing.  Both paths take the same number of cycles, so the count is 
+  // correct to within a cycle or two of the gate signal.  Then the C coded 
+  // ISR (__vector_fcextgate) below does the rest. 
+  // (With FCCHANNEL2 the second counter starts/stops 2 cycles later)
+  asm volatile(
+    "push r24              \n\t"  // 2  
+    "ldi  r24,6            \n\t"  // 1  ext clock, falling edge (count)
+    "sbic %[pin],%[bit]    \n\t"  // 2  skip if pin low (1 if not skipped)
+    "ldi  r24,0            \n\t"  // 1  pin high, stop the counter
+    "sts  %[tccr],r24      \n\t"  // 2  start or stop the counter 
+#if FCCHANNEL2
+    "sts  %[tccr2],r24     \n\t"  // 2  and the second counter
+#endif
+    "pop  r24              \n\t"  // 2
+    "jmp  __vector_fcextgate \n\t"
+    :: [pin] "I" (_SFR_IO_ADDR(PIND)), [bit] "I" (FCEXTGATEBIT), 
+       [tccr] "n" (_SFR_MEM_ADDR(TCCRcB))
+#if FCCHANNEL2
+       , [tccr2] "n" (_SFR_MEM_ADDR(TCCRdB))
+#endif
+  );
+}
+
+ISR(__vector_fcextgate) {
+  // The rest of the ext gate ISR (jumped to from the ISR above).  The counter 
+  // has already been started (gate open) or stopped (gate closed).
+#if FCEXTTIME
+  unsigned long t=FCPRDTIME();            // (same delay after both edges)
+#endif
+  if (TCCRcB)                             // gate opened
+  {
+#if FCEXTTIME
+    fcExtOpen=t;                          // time the gate opened
+#endif
+    fcGateOpen=1;  FreqCtrExtGateEdge(1); // now wait for it to close
+    FCBURSTOPEN();
+    FCTRACEEV(FCEV_GATEOPEN,0);
+  }
+  else                                    // gate closed (or a glitch)
+  {
+    FreqCtrExtGateEdge(0);                // now wait for it to open
+    // count an overflow that happened before the stop but wasn't serviced yet
+    if (TIFRc & (1<<TOVc)) { fcOVF++;  TIFRc = (1<<TOVc); }
+#if FCCHANNEL2
+    if (TIFRd & (1<<TOVd)) { fcOVF2++;  TIFRd = (1<<TOVd); }
+    if (fcGateOpen) fcResult2 = (fcOVF2 << 16) + (unsigned long) TCNTd;
+    TCNTd=0;  fcOVF2=0;
+#endif
+    if (fcGateOpen)                       // (not if turned on mid gate)
+    {
+#if FCEXTTIME
+      fcExtLen=t-fcExtOpen;               // gate length
+#endif
+      fcResult = (fcOVF << FCOVFSHIFT) + (unsigned long) TCNTc;  
+#if FCOVFBUDGET
+      if (fcOverRange) fcResult=FCOVERRANGE;   // (overflows weren't counted)
+#endif
+      _FreqCtrReady=1;
+      FCTRACEEV(FCEV_GATECLOSE,fcResult);  FCTRACEEV(FCEV_READY,fcResult);
+      FCBURSTCLOSE();
+    }
+    fcGateOpen=0;  TCNTc=0;  fcOVF=0;     // ready for the next gate
+  }
+}
+#endif  // FCEXTERN && FCEXTGATEINT>=0
+
+
+static void FreqCtrLatch(void)
+  // Turn off counter and get value, reset TCNTc, turn counter back on.
+  // Move the collected count to fcResult and show ready. 
+{
+  byte svTCCR;  FCCNT svTCNT; 
+#if FCCHANNEL2
+  unsigned int svTCNT2;
+#endif
+
+  // Note: We use TCCRcB<>0 to indicate it's an 'active' cycle 
+  //       (not the first gate cycle after we turned it on)
+  noInterrupts(); // USB seems to interfere less if we shut interrupts off
+  svTCCR=TCCRcB; TCCRcB=0; 
+#if FCCHANNEL2
+  TCCRdB=0;                                 // (stop/start right after TCCRcB)
+  svTCNT2=TCNTd;  TCNTd=0;
+#endif
+  svTCNT=TCNTc; 
+  TCNTc=0; TCCRcB=6;                        // ext clock--falling edge 
+#if FCCHANNEL2
+  TCCRdB=6;
+#endif
+  interrupts(); 
+  fcResult = (fcOVF << FCOVFSHIFT) + (unsigned long) svTCNT;  
+  fcOVF=0; // reset overflow counter
+#if FCPRESENCE
+  fcPresLast=0;                             // (the counter starts over)
+#endif
+#if FCCHANNEL2
+  fcResult2 = (fcOVF2 << 16) + (unsigned long) svTCNT2;  fcOVF2=0;
+#endif
+#if FCOVFBUDGET
+  if (fcOverRange) fcResult=FCOVERRANGE;   // (overflows weren't counted)
+#endif
+  FCTRACEEVM(FCEV_GATECLOSE,fcResult);     // (interrupts are back on)
+  // Note: We use TCCRcB<>0 to indicate it's an 'active' cycle 
+  //       (a full gate period) (not the first gate cycle after we turned it on)
+  if (svTCCR) { _FreqCtrReady=1;  FCTRACEEVM(FCEV_READY,fcResult); }
+}
+
+
+#if FCHWGATE
+extern "C" void SysTimerGateIntFunc(unsigned int Late)
+  // This function is called by the system timer compare B interrupt at the 
+  // exact time the gate should open/close (armed in FreqCtrGateISR).  
+  // 'Late' is the number of timer ticks the gate edge was after the compare 
+  // match.  This is normally always the same value, so the gate length is 
+  // exactly the nominal length.  If not, save the difference so the count can 
+  // be corrected when it is read.  
+  // If this function is defined, it replaces the "weak" definition in the
+  // systimer module. 
+{
+  if (!fcprescaler) return;             // counter was turned off (or ext gate)
+#if FCPERIOD
+  if (FCISPRD(fcGateTime)) return;      // mode changed to period measure 
+#endif
+  FreqCtrLatch(); 
+  fcGateAdj=Late-fcGateLate;  fcGateLate=Late; 
+}
+
+
+static unsigned long FreqCtrAdjust(unsigned long Val, int Adj)
+  // Correct the count 'Val' for a gate that was 'Adj' timer ticks longer than 
+  // the nominal gate time.  (Only if the gate edge ISR was held off longer 
+  // than SYSTIMERGATESYNC) 
+{
+  unsigned long Nom;
+  if (Adj) 
+  {
+    Nom=(unsigned long)fcprescalInit*FCTIME*SYSTIMERTICKS;  // nominal gate (ticks)
+    Val=((unsigned long long)Val*Nom + ((Nom+Adj)>>1)) / (Nom+Adj); 
+  }
+  return Val;
+}
+#endif  // FCHWGATE
+
+
+#if FCTIMERGATE
+// The gate timer is Timer3 (or Timer1 if Timer3 is the system timer).  It 
+// generates the gate signal on its OCxA pin in fast PWM mode (TOP=ICRx) at a 
+// /256 prescale.  The pin is low (gate on) for exactly the gate time and then 
+// high for FCTGDEAD mS.  The OCxA pin must be connected to the ext gate pin.
+#if SYSTIMERNO==3
+#define FCGATETIMERNO         1             // Timer1 OC1A is D9 [PB5] 
+#define FCGATEPIN             9             //   (same pin as PCINTMASK9)
+#else
+#define FCGATETIMERNO         3             // Timer3 OC3A is D5 [PC6]
+#define FCGATEPIN             5             
+#endif
+
+// Gate timer is 'g'
+#define TCCRgA                PASTETOKENS(PASTETOKENS(TCCR,FCGATETIMERNO),A) 
+#define TCCRgB                PASTETOKENS(PASTETOKENS(TCCR,FCGATETIMERNO),B) 
+#define TCNTg                 PASTETOKENS(TCNT,FCGATETIMERNO)
+#define OCRgA                 PASTETOKENS(PASTETOKENS(OCR,FCGATETIMERNO),A)   
+#define ICRg                  PASTETOKENS(ICR,FCGATETIMERNO)
+#define COMgA0                PASTETOKENS(PASTETOKENS(COM,FCGATETIMERNO),A0)   
+#define COMgA1                PASTETOKENS(PASTETOKENS(COM,FCGATETIMERNO),A1)   
+#define WGMg0                 PASTETOKENS(PASTETOKENS(WGM,FCGATETIMERNO),0)   
+#define WGMg1                 PASTETOKENS(PASTETOKENS(WGM,FCGATETIMERNO),1)   
+#define WGMg2                 PASTETOKENS(PASTETOKENS(WGM,FCGATETIMERNO),2)   
+#define WGMg3                 PASTETOKENS(PASTETOKENS(WGM,FCGATETIMERNO),3)   
+#define CSg0                  PASTETOKENS(PASTETOKENS(CS,FCGATETIMERNO),0)   
+#define CSg1                  PASTETOKENS(PASTETOKENS(CS,FCGATETIMERNO),1)   
+#define CSg2                  PASTETOKENS(PASTETOKENS(CS,FCGATETIMERNO),2)   
+
+#define FCTGTICKS             (F_CPU/256/100)            // gate timer ticks per 10mS
+// Gate timer ticks between gates, rounded (62.5 ticks/mS at 16MHz).  The 
+// dead time isn't in the count, so it only needs to be about right. 
+#define FCTGDEADTICKS         ((FCTGDEAD*(F_CPU/256)+500)/1000)
+#if (F_CPU/256)%100
+#warning "F_CPU/256 is not a multiple of 100.  The timer gate time will not be exact."
+#endif
+// ICRx (1S gate + dead time - 1) must fit in 16 bits: FCTGDEAD < 48mS at 16MHz
+#if FCTGDEADTICKS<1 || 100*FCTGTICKS+FCTGDEADTICKS>65536
+#error "FCTGDEAD must be at least 1 gate timer tick and fit with the 1S gate in 16 bits"
+#endif
+
+static void FreqCtrTimerGate(unsigned int Gate)
+  // Start the gate timer with a gate time of 'Gate' 10's of mS (1, 10 or 100) 
+  // or stop it and set it back the way "init" left it (if Gate=0). 
+{
+  TCCRgB=0;                                 // stop the timer
+  if (Gate)
+  {
+    Gate*=FCTGTICKS;                        // gate time in timer ticks
+    ICRg=Gate+FCTGDEADTICKS-1;  OCRgA=Gate-1;  TCNTg=0;
+    // Fast PWM (TOP=ICR), OCxA set on compare match, cleared at BOTTOM. 
+    TCCRgA=(1<<COMgA1)|(1<<COMgA0)|(1<<WGMg1);
+    pinMode(FCGATEPIN,OUTPUT);
+    TCCRgB=(1<<WGMg3)|(1<<WGMg2)|(1<<CSg2); // start timer (/256)
+  }
+  else
+  {
+    pinMode(FCGATEPIN,INPUT);
+    // put timer back in 8-bit phase correct pwm mode, prescale 64 
+    TCCRgA=(1<<WGMg0);  TCCRgB=(1<<CSg1)|(1<<CSg0);
+  }
+}
+#endif  // FCTIMERGATE
+
+
+#if FCPRESENCE
+#if SYSTIMERTICKLESS || !FCINCLUDESYSTIMERLINK
+#error "FCPRESENCE needs FreqCtrGateISR called every 10mS (not SYSTIMERTICKLESS)"
+#endif
+#define FCPRESTIME            ((FCPRESENCE+FCTIME-1)/FCTIME) // 10mS's with no edges
+volatile static byte          fcAbsent=0;         // non-zero if no input (idle)
+static unsigned int           fcPresQuiet=0;      // 10mS's with no input edges
+
+// Same as SysTimerIntFunc... If you define 
+//   extern "C" void FreqCtrPresenceFunc(byte Present) { <some code> }
+// then that function will be called when the input goes away or comes back.
+extern "C" void __FreqCtrPresenceEmpty(byte Present __attribute__((unused))) { }
+extern "C" void FreqCtrPresenceFunc(byte Present) __attribute__ ((weak, alias("__FreqCtrPresenceEmpty")));
+
+static void FreqCtrPresent(void)
+  // The first input edge while idle.  Called by the counter ISR that the 
+  // edge fired: the compare A match armed by FreqCtrPresence in count mode, 
+  // or the period edge in the period modes.  Restart the measurement. 
+{
+  fcAbsent=0;  fcPresQuiet=0;
+#if FCPERIOD
+  if (FCISPRD(fcGateTime))              // this edge starts the next period
+    fcprescaler=fcprescalInit;          //   (and the timeout)
+  else
+#endif
+  {
+    TIMSKc &= ~(1 << OCIEcA);           // (edge interrupt off)
+    TCCRcB=0;  fcprescaler=1;           // throw away count, gate soon
+  }
+  fcPresLast=FCPRESCOUNT();
+  FCTRACEEV(FCEV_PRESENT,0);
+  FreqCtrPresenceFunc(1);
+}
+
+
+static byte FreqCtrPresence(void)
+  // Called every 10mS by FreqCtrGateISR.  The counter itself is the edge 
+  // detector.  If it hasn't moved for FCPRESENCE mS the input is absent: 
+  // publish one "no input" reading and go idle.  While idle the gate and 
+  // period timeout work stop and nothing is polled.  Only one counter 
+  // interrupt is left armed, and FreqCtrPresent restarts the measurement 
+  // when an edge fires it.  Returns non-zero while absent (skip the gate 
+  // work). 
+{
+  unsigned long v;
+  FCCNT n;
+  if (fcAbsent) return 1;               // (idle, waiting for the edge ISR)
+  if (!fcGateTime) return 0;
+#if FCEXTERN
+  if (FCISEXT(fcGateTime)) return 0;    // (gate input, not the counter input)
+#endif
+  v=FCPRESCOUNT();                      // changes on any input edge
+  if (v!=fcPresLast)                    // input edges since last time
+    { fcPresQuiet=0;  fcPresLast=v;  return 0; }
+  if (++fcPresQuiet<FCPRESTIME) return 0;
+  // Quiet too long.  Publish "no input" and go idle. 
+  fcAbsent=1;
+#if FCPERIOD
+  if (FCISPRD(fcGateTime))
+  {
+    // The period edge interrupt is already armed.  The next edge only 
+    // starts a period (the last start time is too old). 
+    fcOVF=0;  fcResult=1;               // (1= period timeout)
+  }
+  else
+#endif
+  {
+    // Arm compare A to match on the next edge.  (If an edge got in before 
+    // OCRcA was written the match would be a whole counter wrap away, but 
+    // then the input is there after all)
+    if (!TCCRcB) TCCRcB=6;              // (counter not started yet)
+    n=TCNTc+1;  OCRcA=n;
+    TIFRc = (1 << OCFcA);  TIMSKc |= (1 << OCIEcA);
+    if (TCNTc!=(FCCNT)(n-1)) 
+      { TIMSKc &= ~(1 << OCIEcA);  fcAbsent=0;  fcPresQuiet=0;  return 0; }
+    fcResult=0;
+  }
+  _FreqCtrReady=1;
+  FCTRACEEV(FCEV_ABSENT,0);
+  FreqCtrPresenceFunc(0);
+  return 1;
+}
+#endif  // FCPRESENCE
+
+
+#if FCPERIOD  
+static inline void FreqCtrPeriodEdge(void)
   // In period measure mode the timer is loaded with FF so that on the first 
   // count, it generates an interrupt. Reload timer with FF for next cycle and 
-  // then subtract current 'micros()' from saved 'micros' to come up with time. 
-#if FCPERIOD  
-  if (fcGateTime >= FCPRDNO)     // if period mode
+  // then subtract current time from saved time to come up with the period. 
+  // (Time is system timer ticks (FCPRDTIME) instead of 'micros()')
+  // With FCPRDCTC the timer is in CTC mode and clears itself, so there is 
+  // nothing to reload (this is called by the compare match ISR). 
+{
+  unsigned long SavMicros;
+  SavMicros=FCPRDTIME();              // save current time
+#if FCPRESENCE
+  if (fcAbsent) FreqCtrPresent();     // first edge while idle 
+#endif
+#if FCOVFBUDGET
+  fcPrdEdges++;                       // (for the interrupt budget)
+#endif
+  //TCCRcB^=1;                        // now look for the other edge
+#if !FCPRDCTC
+  TCNTc=-PrdCnt;                      // reload counter
+#endif
+  if (fcOVF)                          // if we had a valid start transition
+  { 
+    fcResult=SavMicros-fcOVF;         // save new result
+    _FreqCtrReady=1;                  // show ready
+    FCTRACEEV(FCEV_PERIOD,fcResult);
+  }
+  fcprescaler=fcprescalInit;          // restart the timeout timer
+  fcOVF=SavMicros;                    // save time for next time
+}
+#endif  // FCPERIOD
+
+
+#if FCPRESET
+// Preset (batch) counter.  The batch is split into fcPresetSegs segments of 
+// 128..256 counts (Timer0).  The last fcPresetLong are one count longer.  
+// OCRcA is only changed by the compare B ISR in the middle of a segment 
+// (TCNTc==FCPRESETMID), after the counter cleared and at least 63 counts 
+// before the new match, never in the compare A ISR while TCNTc==OCRcA 
+// (the counter clears on the edge after the match). 
+#define FCPRESETMID           (1U<<(FCOVFSHIFT-2))  // OCRcB (64 for Timer0)
+#define FCPRESETMAX           ((FCCNT)((1UL<<FCOVFSHIFT)-1))  // counter MAX (0xFF)
+static unsigned long          fcPresetSegs=0;     // segments per batch (0= preset off)
+static unsigned long          fcPresetLong=0;     // number of long segments
+static FCCNT                  fcPresetOCR=0;      // OCRcA for a short segment
+volatile static unsigned long fcPresetLeft=0;     // segments left in this batch
+static byte                   fcPresetReload=0;   // 1= start the next batch
+static byte                   fcPresetLvl=0;      // output pin level 
+#define FCPRESETOCR(n)        (fcPresetOCR+((n)<=fcPresetLong))  // OCRcA, 'n' left
+
+// Compare output mode: keep the output at level 'l' (set/clear it on match 
+// to what it already is), or toggle it on each match
+#if FCPRESETOUT
+#define FCCOMKEEP(l)          ((l) ? ((1<<COMcA1)|(1<<COMcA0)) : (1<<COMcA1))
+#define FCCOMTOG              (1<<COMcA0)
+#else
+#define FCCOMKEEP(l)          0
+#define FCCOMTOG              0
+#endif
+
+// Same as SysTimerIntFunc... If you define 
+//   extern "C" void FreqCtrPresetFunc(unsigned long Batches) { <some code> }
+// then that function will be called at the end of each preset batch.
+extern "C" void __FreqCtrPresetEmpty(unsigned long Batches __attribute__((unused))) { }
+extern "C" void FreqCtrPresetFunc(unsigned long Batches) __attribute__ ((weak, alias("__FreqCtrPresetEmpty")));
+
+static inline void FreqCtrPresetEdge(void)
+  // A segment of the batch ended (the counter clears on the next edge).  
+  // Nothing is written to OCRcA here (see above).  The output change for 
+  // the end of the batch was set up in hardware by the compare B ISR, so 
+  // it happened on the last count, not when this ISR gets to run. 
+{
+  if (--fcPresetLeft) return;         // more segments in this batch
+  // End of the batch.  (the output changed on the match)
+  fcPresetLvl^=1;
+  if (fcPresetReload)                 // the next batch is counting next
+    fcPresetLeft=fcPresetSegs;
+  else                                // done.  stop the counter
   {
-    {
-      unsigned long SavMicros;
-      SavMicros=micros();                 // save current uS count
-      //TCCR0B^=1;                        // now look for the other edge
-      TCNT0=-PrdCnt;                      // reload counter
-      if (fcOVF)                          // if we had a valid start transition
-      { 
-        fcResult=SavMicros-fcOVF;         // save new result
-        _FreqCtrReady=1;                  // show ready
-      }
-      fcprescaler=fcprescalInit;          // restart the timeout timer
-      fcOVF=SavMicros;                    // save micros for next time
-    }  
+    TCCRcB=0;  TIMSKc &= ~((1 << OCIEcA)|(1 << OCIEcB));  fcPresetSegs=0;
   }
+  fcResult++;  _FreqCtrReady=1;
+  FCTRACEEV(FCEV_PRESET,fcResult);
+  FreqCtrPresetFunc(fcResult);
+}
+
+
+ISR(TIMERc_COMPB_vect) {
+  // Middle of a segment (more than one segment per batch only).  The counter 
+  // has cleared and the match is at least 63 counts away: load this 
+  // segment's length, and if it is the last of the batch change the output 
+  // on its match, else keep it. 
+  OCRcA=FCPRESETOCR(fcPresetLeft);
+  TCCRcA=FCCTCA|FCCOMKEEP((fcPresetLeft==1) ? !fcPresetLvl : fcPresetLvl);
+}
+#endif  // FCPRESET
+
+
+#if (FCPERIOD && FCPRDCTC) || FCPRESET || FCPRESENCE
+ISR(TIMERc_COMPA_vect) {
+  // Counter compare match (the counter cleared itself on the edge that 
+  // matched).  Period modes: PrdCnt edges since the last one.  Preset mode: 
+  // the end of a segment of the batch.  Count mode (FCPRESENCE): the first 
+  // edge while idle. 
+  ISRSTAT_ENTER();
+#if FCPRESENCE
+#if FCPERIOD
+  if (fcAbsent && !FCISPRD(fcGateTime)) 
+#else
+  if (fcAbsent) 
+#endif
+    { FreqCtrPresent();  ISRSTAT_EXIT(ISRID_CTROVF);  return; }
+#endif
+#if FCPRESET
+  if (fcPresetSegs) FreqCtrPresetEdge();
+#if FCPERIOD && FCPRDCTC
+  else
+#endif
+#endif
+#if FCPERIOD && FCPRDCTC
+  FreqCtrPeriodEdge();
+#endif
+  ISRSTAT_EXIT(ISRID_CTROVF);
+}
+#endif
+
+
+#if !FCFASTOVF
+ISR(TIMERc_OVF_vect) {
+  // Frequency counter counting interrupt service routine. 
+  // Increment the overflow counter when we run out of counts in the hardware
+  // register (TCNTc). This happens every 256 counts (65536 if counting with 
+  // Timer1).  (Freq counter mode)
+  // In period measure mode, measure the period (FreqCtrPeriodEdge).
+  ISRSTAT_ENTER();
+#if FCPERIOD && !FCPRDCTC
+  if (FCISPRD(fcGateTime))       // if period mode
+    FreqCtrPeriodEdge();
   else                          // ordinary frequency counter.
 #endif  // FCPERIOD
+  {
     fcOVF++; 
+#if FCTRACEOVF
+    FCTRACEEV(FCEV_OVF,fcOVF);
+#endif
+  }
+  ISRSTAT_EXIT(ISRID_CTROVF);
+}
+
+#else   // FCFASTOVF
+
+ISR(TIMERc_OVF_vect, ISR_NAKED) {
+  // Same as above, but hand coded so only one register is saved.  fcOVF is 
+  // used as a 24 bit counter (plenty for 100S at 8MHz) and the upper bytes 
+  // are only touched when the lower byte carries.  The period mode (if 
+  // enabled and not FCPRDCTC) jumps to the normal C coded ISR 
+  // (__vector_fcprd) below. 
+  // CPU cycles (from the instruction timings) for the usual count mode case:
+  //   interrupt response+vector jmp 7, ISR 22 (17 without the period check, 
+  //   the default with FCPRDCTC), reti 4 = 33 (28) cycles, compared to about 
+  //   70 for the C version.  To measure it, set FCFASTOVFSCOPE to a PORTB 
+  //   bit: the pin is high for the ISR body, so the scope pulse width plus 
+  //   about 13 cycles (response, jmp, sbi, reti) is the whole ISR. 
+  asm volatile(
+#if FCFASTOVFSCOPE>=0
+    "sbi  %[port],%[bit]   \n\t"  // 2  scope pulse start (not counted above)
+#endif
+    "push r24              \n\t"  // 2  save r24 and SREG
+    "in   r24,__SREG__     \n\t"  // 1
+    "push r24              \n\t"  // 2
+#if FCPERIOD && !FCPRDCTC
+    "lds  r24,%[mode]      \n\t"  // 2  if period mode, go to the C ISR
+    "subi r24,%[prd]       \n\t"  // 1
+    "cpi  r24,3            \n\t"  // 1
+    "brlo 2f               \n\t"  // 1
+#endif
+    "lds  r24,%[ovf]       \n\t"  // 2  fcOVF++ (24 bits)
+    "inc  r24              \n\t"  // 1
+    "sts  %[ovf],r24       \n\t"  // 2
+    "brne 1f               \n\t"  // 2  done if no carry
+    "lds  r24,%[ovf]+1     \n\t"
+    "inc  r24              \n\t"
+    "sts  %[ovf]+1,r24     \n\t"
+    "brne 1f               \n\t"
+    "lds  r24,%[ovf]+2     \n\t"
+    "inc  r24              \n\t"
+    "sts  %[ovf]+2,r24     \n\t"
+    "1:                    \n\t"
+    "pop  r24              \n\t"  // 2  restore SREG and r24
+    "out  __SREG__,r24     \n\t"  // 1
+    "pop  r24              \n\t"  // 2
+#if FCFASTOVFSCOPE>=0
+    "cbi  %[port],%[bit]   \n\t"  // 2  scope pulse end
+#endif
+    "reti                  \n\t"  // 4
+#if FCPERIOD && !FCPRDCTC
+    "2:                    \n\t"
+    "pop  r24              \n\t"  // restore SREG and r24 and let the C 
+    "out  __SREG__,r24     \n\t"  //   ISR do the period measurement
+    "pop  r24              \n\t"
+#if FCFASTOVFSCOPE>=0
+    "cbi  %[port],%[bit]   \n\t"
+#endif
+    "jmp  __vector_fcprd   \n\t"
+#endif
+    :: [ovf] "i" (&fcOVF), [mode] "i" (&fcGateTime), [prd] "M" (FCPRDNO),
+       [port] "I" (_SFR_IO_ADDR(PORTB)), [bit] "I" (FCFASTOVFSCOPE & 7)
+  );
+}
+
+#if FCPERIOD && !FCPRDCTC
+ISR(__vector_fcprd) {
+  // Period mode part of the overflow ISR (jumped to from the ISR above).
+  FreqCtrPeriodEdge();
+}
+#endif  // FCPERIOD
+#endif  // FCFASTOVF
+
+
+#if FCCHANNEL2
+ISR(TIMERd_OVF_vect) {
+  // Second counter (Timer1) overflow.  Every 65536 counts, so the C version 
+  // is fine here. 
+  fcOVF2++; 
 }
+#endif
+
+
+
+
+#if FCOVFBUDGET
+static void FreqCtrBudget(void)
+  // Called every 10mS by FreqCtrGateISR.  If the counter interrupt ran more 
+  // than FCOVFMAX times in the last 10mS, turn it off and report over range.  
+  // Every FCOVRPROBE*10mS turn it back on for 10mS to see if the input is 
+  // back in range.  The first count (or period) after that is thrown away 
+  // because it missed interrupts. 
+{
+  unsigned int n;
+  if (fcOverRange>1)                  // over range.  Time to try again? 
+  {
+    if (--fcOverRange==1) 
+    {
+#if FCPERIOD
+      fcPrdEdges=0;
+      if (FCISPRD(fcGateTime)) fcOVF=0;   // (no valid period start time)
+#endif
+      fcOVFLast=fcOVF;  
+      TIFRc |= FCCTRIF;  TIMSKc |= FCCTRIE;
+    }
+    return;
+  }
+  if (!fcGateTime || !(TIMSKc & FCCTRIE)) return;
+  // Number of counter interrupts in the last 10mS
+#if FCPERIOD
+  if (FCISPRD(fcGateTime)) { n=fcPrdEdges;  fcPrdEdges=0; }
+  else
+#endif
+  {
+    n=(fcOVF>=fcOVFLast) ? fcOVF-fcOVFLast : fcOVF;   // (fcOVF reset at gate)
+    fcOVFLast=fcOVF;
+  }
+  if (n > FCOVFMAX)                   // too many.  Turn off the interrupt
+  {
+    TIMSKc &= ~FCCTRIE;
+    if (!fcOverRange) { fcResult=FCOVERRANGE;  _FreqCtrReady=1; }
+    fcOverRange=FCOVRPROBE;
+    FCTRACEEV(FCEV_OVERRANGE,n);
+  }
+  else if (fcOverRange)               // back in range.  
+  {
+    fcOverRange=0;
+    // Throw away the count in progress (next gate starts a new count). 
+    // (Period mode restarted when the interrupt was turned back on)
+#if FCPERIOD
+    if (!FCISPRD(fcGateTime)) 
+#endif
+      TCCRcB=0;
+  }
+}
+#endif  // FCOVFBUDGET
 
 
 void FreqCtrGateISR(void)
@@ -410,13 +1489,18 @@ void FreqCtrGateISR(void)
   // accurate timer) when FCGateTime is not zero. 
   // This is normally done in the ISR of one of the timers in the micro. 
 {
-  byte svTCCR,svTCNT; 
-
+  ISRSTAT_ENTER();
+#if FCOVFBUDGET
+  FreqCtrBudget();                        // limit the counter interrupts
+#endif
+#if FCPRESENCE
+  if (FreqCtrPresence()) { ISRSTAT_EXIT(ISRID_GATE);  return; }  // (idle)
+#endif
   // If it's gate time.     Note: fcprescaler will be 0 if counter is off
   if (fcprescaler && !--fcprescaler)      
   {
 #if FCPERIOD
-    if (fcGateTime >= FCPRDNO)
+    if (FCISPRD(fcGateTime))
     {
 #if PERIODTIMOUT
       // For period measurement this is a timeout.  If we don't get 
@@ -424,31 +1508,34 @@ void FreqCtrGateISR(void)
       // time, then restart the timer and report no input frequency found.
       if (!_FreqCtrReady)
       {
-        TCNT0=-PrdCnt;                    // reload counter
-        TIFR0 |= (1 << TOV0);             // reset a possible int that might have happened
+#if !FCPRDCTC
+        TCNTc=-PrdCnt;                    // reload counter
+        TIFRc |= (1 << TOVc);             // reset a possible int that might have happened
+#endif
         fcOVF=0;                          // show we don't have valid start transition
         fcResult=1;  _FreqCtrReady=1;     // set result to 1, show ready
+#if FCOVFBUDGET
+        if (fcOverRange) fcResult=FCOVERRANGE;
+#endif
+        FCTRACEEV(FCEV_TIMEOUT,0);
       }
 #endif      
     }
     else
 #endif    // FCPERIOD
     {
-      // Turn off counter and get value, reset TCNT0, turn counter back on.
-      // Note: We use TCCR0B<>0 to indicate it's an 'active' cycle 
-      //       (not the first gate cycle after we turned it on)
-      noInterrupts(); // USB seems to interfere less if we shut interrupts off
-      svTCCR=TCCR0B; TCCR0B=0; svTCNT=TCNT0; 
-      TCNT0=0; TCCR0B=6;                        // ext clock--falling edge 
-      interrupts(); 
-      fcResult = (fcOVF << 8) + (unsigned long) svTCNT;  
-      fcOVF=0; // reset overflow counter
-      // Note: We use TCCR0B<>0 to indicate it's an 'active' cycle 
-      //       (a full gate period) (not the first gate cycle after we turned it on)
-      if (svTCCR) _FreqCtrReady=1;
+#if FCHWGATE
+      // Let compare unit B of the system timer time the actual gate edge. 
+      // (calls SysTimerGateIntFunc later in this mS)
+      SysTimerGateArm();
+      FCTRACEEV(FCEV_ARM,fcprescalInit);
+#else
+      FreqCtrLatch();
+#endif
     } 
     fcprescaler=fcprescalInit;          // reinit the prescaler
   }     // if (fcprescaler && !--fcprescaler)       
+  ISRSTAT_EXIT(ISRID_GATE);
 }
 
 
@@ -463,8 +1550,168 @@ byte FrequencyCounter::available(void) { return _FreqCtrReady; }
   // Returns true after each new update. False after reading the value.
 
 
+unsigned long FrequencyCounter::gatetime(void)
+  // Returns the length of the last ext gate (mode 6) in system timer ticks 
+  // (SYSTIMERTICKSPERSEC per second, or SYSTIMERPLLTPS if SYSTIMERPLLTS).
+  // 0 if not measured yet (or FCEXTTIME is 0). 
+{
+#if FCEXTERN && FCEXTTIME
+  unsigned long Len;
+  noInterrupts();  Len=fcExtLen;  interrupts();
+  return Len;
+#else
+  return 0;
+#endif
+}
+
+
+#if FCCHANNEL2
+unsigned long FrequencyCounter::read2(void)
+  // Returns the count of the second input (Timer1) from the same gate as 
+  // the last read, times the prescaler like read(bool).  (0 in the period 
+  // modes) 
+{
+  unsigned long Val=fcRead2;
+#if FCHWGATE
+  Val=FreqCtrAdjust(Val,fcGateAdj);   // correct for a late gate edge
+#endif
+#if FCPRESCALER && (FCPRESCALER != 1)
+  Val*=FCPRESCALER;                 // multiply Val by the prescaler
+#endif
+  return Val;
+}
+
+
+char *FrequencyCounter::read2(char *St)
+  // Returns a string of the second input's frequency from the same gate as 
+  // the last read.  Scaled for the gate time like read(St,..). 
+{
+  unsigned long Val=read2();  unsigned int dp;
+  if (!St) return St;
+#if FCPERIOD
+  if (FCISPRD(fcGateTime)) Val=0;   // (not counting) 
+#endif
+#if FCEXTERN && FCEXTTIME
+  if (fcGateTime==FCEXTNO && fcRead2Len)   // ext gate.  Count / gate length
+    return FreqCtrExtStr(St,Val,fcRead2Len);
+#endif
+  if (fcprescalInit<=100)           // integer value only (10mS, 100mS, 1S)
+  {
+    if (fcprescalInit) Val*=(100/fcprescalInit); 
+    sprintf_P(St,PSTR("%lu"),Val);
+  }
+  else                              // integer and fraction (10s, 100s)
+  { 
+    dp=fcprescalInit/100;
+    sprintf_P(St,(dp>10)?PSTR("%lu.%02u"):PSTR("%lu.%u"),Val/dp,(unsigned)(Val%dp));
+  }
+  return St;
+}
+#else
+unsigned long FrequencyCounter::read2(void)  { return 0; }
+char *FrequencyCounter::read2(char *St) { if (St) strcpy_P(St,PSTR("0"));  return St; }
+#endif
+
+
+#if FCEXTERN && FCBURST
+byte FrequencyCounter::arm(FCGate *Buf, byte Gates)
+  // Capture the next 'Gates' ext gates (the first one that opens after 
+  // this call and the ones after it) into 'Buf', then stop.  Returns 0 if 
+  // not in an ext gate or timer gated mode (or Gates is 0) else 1.  
+{
+  fcBurstState=0;                         // (stop any capture in progress)
+  if (!Buf || !Gates || !FCISEXT(fcGateTime)) return 0;
+  noInterrupts();  
+  fcBurstBuf=Buf;  fcBurstMax=Gates;  fcBurstN=0;  fcBurstState=1;
+  interrupts();
+  return 1;
+}
+
+
+byte FrequencyCounter::captured(void)  { return fcBurstN; }
+#else
+byte FrequencyCounter::arm(FCGate *Buf __attribute__((unused)), 
+                           byte Gates __attribute__((unused))) { return 0; }
+byte FrequencyCounter::captured(void)  { return 0; }
+#endif
+  // Returns the number of gates captured since arm().  The capture is 
+  // done when it equals 'Gates'.
+
+
+#if FCPRESENCE
+byte FrequencyCounter::present(void)   { return !fcAbsent; }
+#else
+byte FrequencyCounter::present(void)   { return 1; }
+#endif
+  // Returns false after no input edges for FCPRESENCE mS (the counter is 
+  // idle), true when there is an input.  (Always true if FCPRESENCE is 0)
+
+
+#if FCOVFBUDGET
+byte FrequencyCounter::overrange(void) { return fcOverRange; }
+#else
+byte FrequencyCounter::overrange(void) { return 0; }
+#endif
+  // Returns true while the counter interrupt is turned off because the 
+  // input is too fast (or noisy) for the FCOVFBUDGET interrupt budget. 
+
+
+#if FCPRESET
+byte FrequencyCounter::preset(unsigned long Count, byte Reload)
+  // Preset (batch) counter.  Count 'Count' input pulses, then on the last 
+  // one change the output pin (in hardware) and call FreqCtrPresetFunc.  
+  // 'Reload' non-zero to start the next batch with the next pulse, else 
+  // stop.  preset(0,0) stops.  Returns 1.
+{
+  unsigned long s;
+  mode(0);                                // (frequency counter off)
+  if (!Count) return 1;
+  // Segments of at most the counter size.  (each >= half of it if more than 1)
+  s=((Count-1)>>FCOVFSHIFT)+1;
+  pinMode(FCINPIN, INPUT_PULLUP);         // Counter clock input
+#if FCPRESETOUT
+  digitalWrite(FCOUTPIN, LOW);  pinMode(FCOUTPIN, OUTPUT);
+#endif
+  noInterrupts();
+  fcPresetSegs=s;  fcPresetLeft=s;  fcPresetLong=Count%s;  fcPresetOCR=Count/s-1;
+  fcPresetReload=Reload;  fcPresetLvl=0;
+  fcResult=0;  _FreqCtrReady=0;
+  // The counter matches on the edge that makes TCNTc==OCRcA and clears on 
+  // the one after, so a segment is OCRcA+1 counts.  Start at MAX so the 
+  // first edge wraps to 0 and the first segment is that long too.  (The 
+  // TCNTc write blocks a match at MAX, so a 256 count segment is ok)
+  TCCRcB=0;  TCNTc=FCPRESETMAX;  OCRcA=FCPRESETOCR(s);  OCRcB=FCPRESETMID;
+#if FCPRESETOUT
+  TCCRcA=FCCTCA|FCCOMKEEP(0);  FCFORCEOC();   // output starts low
+#endif
+  // One segment: OCRcA never changes, toggle on every match.  Else keep 
+  // the output until the last one (set by the compare B ISR). 
+  TCCRcA=FCCTCA|((s==1) ? FCCOMTOG : FCCOMKEEP(0));
+  TIFRc = (1 << OCFcA)|(1 << OCFcB);  
+  TIMSKc |= (1 << OCIEcA)|((s>1) ? (1 << OCIEcB) : 0);
+  TCCRcB=FCCTCB|6;                        // start counting (ext clock, falling)
+  interrupts();
+  return 1;
+}
+
+
+unsigned long FrequencyCounter::batches(void)
+  // Returns the number of batches done since preset().  available() is 
+  // true after each batch and false after calling this. 
+{
+  unsigned long n;
+  noInterrupts();  n=fcResult;  _FreqCtrReady=0;  interrupts();
+  return n;
+}
+#else
+byte FrequencyCounter::preset(unsigned long Count __attribute__((unused)), 
+                              byte Reload __attribute__((unused))) { return 0; }
+unsigned long FrequencyCounter::batches(void)  { return 0; }
+#endif
+
+
 sbyte FrequencyCounter::mode(void)     { return fcGateTime;  }
-  // Returns the current gate mode/time. (0..9)
+  // Returns the current gate mode/time. (0..12)
 
 
 sbyte FrequencyCounter::mode(sbyte GateTime)
@@ -475,7 +1722,8 @@ sbyte FrequencyCounter::mode(sbyte GateTime)
   //   4= 10 Sec gate time 5= 100 Sec gate time, 6= Ext Gate (low going).
   //   7= Period mode (1 period), 8= Period mode (average 10 periods)
   //   9= Period mode (average 100 periods)
-  // GateTime values 6..9 are available only if compile option is enabled.
+  //   10= 1 Sec timer gate, 11= 10mS timer gate, 12= 100mS timer gate
+  // GateTime values 6..12 are available only if compile option is enabled.
   // Function returns the current gate time or -1 if error.     
 {
   unsigned int t=0; byte i,j; 
@@ -485,16 +1733,27 @@ sbyte FrequencyCounter::mode(sbyte GateTime)
 
   if (GateTime < 0) goto GetGate;
   if (GateTime > FCMODEMAX) return -1;  
+  FCTRACEEVM(FCEV_MODE,GateTime);
+#if FCTIMERGATE
+  if (FCISTG(svGateTime)) FreqCtrTimerGate(0);   // stop the gate timer
+#endif
+#if FCEXTERN && FCEXTGATEINT>=0
+  if (FCISEXT(svGateTime)) FreqCtrExtGate(0);    // (ISR would start the counter)
+#endif
   fcGateTime=GateTime;
 #if FCEXTERN
   if (GateTime==FCEXTNO) GateTime=1;
 #endif  // FCEXTERN
+#if FCTIMERGATE
+  // Timer gated modes are 1S, 10mS, 100mS just like modes 1..3 
+  if (FCISTG(GateTime)) GateTime-=(FCTGNO-1);
+#endif
   // Convert gate time to sequential times 0=off, 1=10mS, 2=100mS, 3=1S, 4=10S,5=100s
   if (GateTime && GateTime<4)  if (!--GateTime) GateTime=3; 
   // Create prescale value:  0=off, 1=10mS, 10=100mS, 100=1S, 1000=10S, 10000=100s
   if (GateTime) for (i=1,t=1; i<GateTime; i++)  t*=10; 
 #if FCPERIOD
-  if (fcGateTime >= FCPRDNO) 
+  if (FCISPRD(fcGateTime)) 
   {   
     // Determine value for PrdCnt (1, 10 or 100 averages)
     for (j=(GateTime-FCPRDNO),PrdCnt=1,i=0; i<j; i++) PrdCnt*=10; 
@@ -502,32 +1761,89 @@ sbyte FrequencyCounter::mode(sbyte GateTime)
   }
 #endif
   fcprescaler=fcprescalInit=t;  
+#if FCHWGATE
+  fcGateAdj=0;
+#endif
+#if FCOVFBUDGET
+  fcOverRange=0;  fcOVFLast=0;
+#endif
+#if FCEXTERN && FCEXTTIME
+  fcExtLen=0;
+#endif
+#if FCEXTERN && FCBURST
+  fcBurstState=0;
+#endif
+#if FCPRESENCE
+  fcAbsent=0;  fcPresQuiet=0;  fcPresLast=0;
+#endif
+#if (FCPERIOD && FCPRDCTC) || FCPRESET || FCPRESENCE
+  TIMSKc &= ~(1 << OCIEcA);   // (period compare / idle edge int, turned on below)
+#endif
+#if FCPRESET
+  TIMSKc &= ~(1 << OCIEcB);   fcPresetSegs=0;   // (stops the preset counter)
+#endif
+#if FCCHANNEL2
+  TCCRdB=0;  TIMSKd &= ~(1 << TOIEd);  // (started below if counting)
+  fcResult2=0;  fcRead2=0;  fcRead2Len=0;
+#endif
   if (fcprescaler)            // if freq counter is on
   {
     fcprescaler=1;            // give us some time to set up (2), set gate time
-    pinMode(6, INPUT_PULLUP); // Timer 0 Clock input is always on D6 (ProMicro)
-    // Note: Don't turn on extinput on TCCRB (TCCR0B=6).. Let the ISR do it. 
+#if FCINCLUDESYSTIMERLINK && SYSTIMERTICKLESS
+    SysTimerNext(FCTIME);     // start the gate timing 
+#elif FCINCLUDESYSTIMERLINK && SYSTIMERWHEEL
+    if (!SysTimerActive(&fcGateNode)) SysTimerAdd(&fcGateNode,FCTIME,FCTIME,FreqCtrGateISR);
+#endif
+    pinMode(FCINPIN, INPUT_PULLUP); // Counter clock input (T0 is D6 on ProMicro)
+#if FCFASTOVF && FCFASTOVFSCOPE>=0
+    DDRB |= (1 << FCFASTOVFSCOPE);  // scope pulse pin (overflow ISR time)
+#endif
+    // Note: Don't turn on extinput on TCCRB (TCCRcB=6).. Let the ISR do it. 
     //       This prevents user from reading a partial frequency count.
     //       See FreqCtrGateISR
 #if FCPERIOD
-    if (fcGateTime >= FCPRDNO)
+    if (FCISPRD(fcGateTime))
     {
+#if FCPRDCTC
+      // CTC mode.  Compare match (and clear) every PrdCnt transitions
+      TCCRcA=FCCTCA; TCNTc=0;  OCRcA=PrdCnt-1;
+      fcOVF=0;   
+      TCCRcB = FCCTCB|6;        // Turn on the counter
+#else
       // Set timer 0 to max count so it rolls over on one external transition 
-      TCCR0A=0; TCNT0=-PrdCnt;  
+      TCCRcA=0; TCNTc=-PrdCnt;  
       fcOVF=0;   
       // Turn on the counter
-      TCCR0B = 6; 
-      TIFR0  |= (1 << TOV0);    // reset any residual int
-      TIMSK0 |= (1 << TOIE0);   // enable timer overflow interrupt
+      TCCRcB = 6; 
+#endif
+      TIFRc  |= FCPRDIF;        // reset any residual int
+      TIMSKc |= FCPRDIE;        // enable timer overflow (compare) interrupt
     }
     else
 #endif    // FCPERIOD
     {
-      TCCR0A = 0;   TCCR0B = 0; // Prescaler.. 0=timer off, 1=/1,2=/8,3=/64,4=/256,5=/1024,6=/ext fall,7=/ext rise
-      TCNT0 = 0;
-      TIMSK0 |= (1 << TOIE0);   // enable timer overflow interrupt
+      TCCRcA = 0;   TCCRcB = 0; // Prescaler.. 0=timer off, 1=/1,2=/8,3=/64,4=/256,5=/1024,6=/ext fall,7=/ext rise
+      TCNTc = 0;
+      TIMSKc |= (1 << TOIEc);   // enable timer overflow interrupt
+#if FCCHANNEL2
+      // Second counter, same as above (the gate code starts it with TCCRcB)
+      pinMode(FCINPIN2, INPUT_PULLUP);
+      TCCRdA = 0;  TCNTd = 0;  fcOVF2 = 0;
+      TIFRd = (1 << TOVd);  TIMSKd |= (1 << TOIEd);
+#endif
 #if FCEXTERN
-      if (fcGateTime==FCEXTNO) { PCH.enable(FCEXTGATEMSK); fcprescaler=0; }
+      if (FCISEXT(fcGateTime)) 
+      { 
+#if FCEXTGATEINT>=0
+        FreqCtrExtGate(1);  fcprescaler=0; 
+#else
+        PCH.attach(FCEXTGATEMSK,PCCHANGE,FreqCtrExtGatePC);
+        PCH.enable(FCEXTGATEMSK); fcprescaler=0; 
+#endif
+#if FCTIMERGATE
+        if (FCISTG(fcGateTime)) FreqCtrTimerGate(fcprescalInit);
+#endif
+      }
 #endif
     }
     interrupts();
@@ -535,10 +1851,17 @@ sbyte FrequencyCounter::mode(sbyte GateTime)
   else                          // Turn freq counter off
   {
     //fcprescalInit=fcprescaler=0;  // Shut off the counting (already done above)
-    TCCR0A = 0;   TCCR0B = 0;   // Prescaler.. 0=timer off, 1=/1,2=/8,3=/64,4=/256,5=/1024,6=/ext fall,7=/ext rise
-    TIMSK0 &= ~(1 << TOIE0);    // disable timer overflow interrupt
+    TCCRcA = 0;   TCCRcB = 0;   // Prescaler.. 0=timer off, 1=/1,2=/8,3=/64,4=/256,5=/1024,6=/ext fall,7=/ext rise
+    TIMSKc &= ~(1 << TOIEc);    // disable timer overflow interrupt
 #if FCEXTERN
-    if (svGateTime==FCEXTNO) PCH.disable(FCEXTGATEMSK);
+#if FCEXTGATEINT>=0
+    if (FCISEXT(svGateTime)) FreqCtrExtGate(0);
+#else
+    if (FCISEXT(svGateTime)) { PCH.disable(FCEXTGATEMSK);  PCH.detach(FCEXTGATEMSK); }
+#endif
+#endif
+#if FCINCLUDESYSTIMERLINK && SYSTIMERWHEEL
+    SysTimerRemove(&fcGateNode);
 #endif
   }
   _FreqCtrReady=0; fcResult=0;
@@ -602,22 +1925,53 @@ char *FrequencyCounter::read(char *St,  bool Wait)
   // is configurable and defaults to 5 seconds.
 {
   char dp; unsigned long scale; unsigned long Val; 
+#if FCHWGATE
+  int Adj;
+#endif
 
   if (!St) return St;               // if no place to put result, return NULL;
   // Wait if requested.  (only if counter is on and wait is true)
+  ISRLOAD_IDLEBEGIN();               // (CPU load meter, if ISRLOAD)
   while (fcGateTime && Wait && !_FreqCtrReady) { yield(); }   
-  noInterrupts();  Val = fcResult;  interrupts();   // Get the frequency read
+  ISRLOAD_IDLEEND();
+  FCTRACEEVM(FCEV_READ,Wait);
+  noInterrupts();  Val = fcResult;                  // Get the frequency read
+#if FCHWGATE
+  Adj = fcGateAdj; 
+#endif
+#if FCEXTERN && FCEXTTIME
+  unsigned long Len = fcExtLen;
+#endif
+#if FCCHANNEL2
+  fcRead2 = fcResult2;              // (the same gate, for read2)
+#if FCEXTERN && FCEXTTIME
+  fcRead2Len = Len;
+#endif
+#endif
+  interrupts();
+#if FCOVFBUDGET
+  if (Val==FCOVERRANGE) 
+    { strcpy_P(St,PSTR("OVER"));  _FreqCtrReady=0;  return St; }
+#endif
+#if FCEXTERN && FCEXTTIME
+  if (fcGateTime==FCEXTNO && Len)   // ext gate.  Count / measured gate length
+  {
+    _FreqCtrReady=0;                // Show we've read this value 
+    return FreqCtrExtStr(St,(unsigned long long)Val*FCPRESCALER,Len);
+  }
+#endif
 #if  FCPERIOD
-  if (fcGateTime >= FCPRDNO)  
+  if (FCISPRD(fcGateTime))  
   {
 #if FRQCTRDEBUG
     printfROM("Cnt=%lu (%lX)  ",Val,Val);
 #endif
     dp=5;  scale=100000;                  // Set #dp's and scale
     // If the period is ready and large enough to not overrun an unsigned long
-    if (_FreqCtrReady && Val>(24*PrdCnt)) 
+    if (_FreqCtrReady && Val>(FCPRDMIN*PrdCnt)) 
     { 
-      Val=(100000000000ULL*PrdCnt)/Val;   // Convert period to frequency
+      // Convert period (FCPRDTPS counts/sec) to frequency
+      Val=((unsigned long long)(100000ULL*FCPRDTPS)*PrdCnt)/Val;
     }
     else
     { 
@@ -630,6 +1984,9 @@ char *FrequencyCounter::read(char *St,  bool Wait)
 #endif   // FCPERIOD 
 #if FCPERIOD
   {     // else regular count mode
+#if FCHWGATE
+    Val=FreqCtrAdjust(Val,Adj);     // correct for a late gate edge
+#endif
     scale=fcprescalInit/100;   dp=Log10I(fcprescalInit)-2; 
     if (dp<0) { scale=1; while (dp<0) { Val*=10; dp++; } }
     //Note: this is longer -->  if (dp<0) { scale=1; Val*=(100/fcprescalInit); dp=0; }
@@ -652,6 +2009,9 @@ char *FrequencyCounter::read(char *St,  bool Wait)
 #else     // shorter code.. Use with no period measure functionality
     byte fp; 
     dp=0;
+#if FCHWGATE
+    Val=FreqCtrAdjust(Val,Adj);     // correct for a late gate edge
+#endif
     //if (fcprescalInit)          // include if no divide by 0 is allowed
     {
 #if FCPRESCALER && (FCPRESCALER != 1)
@@ -686,15 +2046,70 @@ unsigned long FrequencyCounter::read(bool Wait)
   // do this or use the string version of this function for a corrected value. 
   // 'Wait' is non-zero to wait for the next (a "fresh") frequency count, or 
   // 0 to return the  last frequency read.
+  // In period mode the value is the time of the periods in system timer 
+  // ticks (SYSTIMERTICKSPERSEC per second, or SYSTIMERPLLTPS if SYSTIMERPLLTS)
 {
   unsigned long Val;
+#if FCHWGATE
+  int Adj;
+#endif
   // Wait if requested.  (only if counter is on and wait is true)
+  ISRLOAD_IDLEBEGIN();               // (CPU load meter, if ISRLOAD)
   while (fcGateTime && Wait && !_FreqCtrReady) { yield(); }   
+  ISRLOAD_IDLEEND();
+  FCTRACEEVM(FCEV_READ,Wait);
   _FreqCtrReady=0;                  // Show we've read this value 
-  noInterrupts(); Val=fcResult; interrupts();
+  noInterrupts(); Val=fcResult; 
+#if FCHWGATE
+  Adj=fcGateAdj;
+#endif
+#if FCCHANNEL2
+  fcRead2 = fcResult2;              // (the same gate, for read2)
+#if FCEXTERN && FCEXTTIME
+  fcRead2Len = fcExtLen;
+#endif
+#endif
+  interrupts();
+#if FCHWGATE
+  Val=FreqCtrAdjust(Val,Adj);       // correct for a late gate edge
+#endif
 #if FCPRESCALER && (FCPRESCALER != 1)
     Val*=FCPRESCALER;               // multiply Val by the prescaler
 #endif
   return Val;
 }
 
+
+
+#if FCTRACE
+byte FrequencyCounter::trace(FCTraceEvent *Buf)
+  // Copy the trace events written since the last call (oldest first) to 
+  // 'Buf' and return the number copied.  'Buf' must hold FCTRACESIZE 
+  // events.  If more than that were written, only the newest are kept 
+  // (see tracelost).  Interrupts are only turned off while each event is 
+  // copied (not for the whole copy) so the overflow ISR isn't held off.  
+  // Events written while we copy are copied too, until 'Buf' is full. 
+{
+  byte n=0;
+  uint8_t oldSREG = SREG;
+  while (n<FCTRACESIZE)
+  {
+    cli();
+    if (fcTraceTail==fcTraceHead) { SREG=oldSREG;  break; }
+    Buf[n++]=fcTrace[fcTraceTail & (FCTRACESIZE-1)];  fcTraceTail++;
+    SREG=oldSREG;
+  }
+  return n;
+}
+
+
+unsigned int FrequencyCounter::tracelost(void)
+  // Returns the number of trace events written over before they were read 
+  // (65535 max) since the last call, and clears it. 
+{
+  unsigned int n;
+  uint8_t oldSREG = SREG;
+  cli();  n=fcTraceLost;  fcTraceLost=0;  SREG=oldSREG;
+  return n;
+}
+#endif  // FCTRACE
@@ -45,11 +45,12 @@ class FrequencyCounter
       //   4= 10 Sec gate time 5= 100 Sec gate time, 6= Ext Gate (low going).
       //   7= Period mode (1 period), 8= Period mode (average 10 periods)
       //   9= Period mode (average 100 periods)
-      // GateTime values 6..9 are available only if compile option is enabled.
+      //   10= 1 Sec timer gate, 11= 10mS timer gate, 12= 100mS timer gate
+      // GateTime values 6..12 are available only if compile option is enabled.
       // Function returns the current gate time or -1 if error.     
 
     sbyte mode(void);
-      // Returns the current gate mode/time. (0..9)
+      // Returns the current gate mode/time. (0..12)
 
     byte available(void);
       // Returns true after each new update. False after reading the value.
@@ -77,6 +78,9 @@ class FrequencyCounter
       // The input signal must provide 2 (a complete wave), 11 or 101 transitions  
       // within the timeout period or '0.00000' is returned.  The timeout period 
       // is configurable and defaults to 5 seconds.
+      // If the input is over range (FCOVFBUDGET) then 'OVER' is returned.
+      // In ext gate mode (6) the count is divided by the measured gate length 
+      // (FCEXTTIME) so the value is the frequency in Hz (3 decimals). 
 
     unsigned long read(bool Wait);
       // Read the frequency counter and return the value as an unsigned long. 
@@ -85,6 +89,65 @@ class FrequencyCounter
       // do this or use the string version of this function for a corrected value. 
       // 'Wait' is non-zero to wait for the next (a "fresh") frequency count, or 
       // 0 to return the  last frequency read.
+      // In period mode the value is the time of the periods in system timer 
+      // ticks (SYSTIMERTICKSPERSEC per second, or SYSTIMERPLLTPS if SYSTIMERPLLTS)
+      // If the input is over range (FCOVFBUDGET) then FCOVERRANGE is returned.
+
+    unsigned long gatetime(void);
+      // Returns the length of the last ext gate (mode 6) in system timer ticks 
+      // (SYSTIMERTICKSPERSEC per second, or SYSTIMERPLLTPS if SYSTIMERPLLTS).
+      // 0 if not measured yet (or FCEXTTIME is 0).  read(bool) still returns 
+      // the raw count, so count/gatetime()*ticks per second is the frequency.
+
+    char *read2(char *St);
+      // Returns a string of the frequency of the second input (FCCHANNEL2) 
+      // in the same form as read(St,..).  The value is from the same gate as 
+      // the last read (so call read first, e.g. with Wait).  "0" in the 
+      // period modes or if FCCHANNEL2 is 0.
+
+    unsigned long read2(void);
+      // Same as read2(St) but returns the raw count (like read(bool)).
+
+    byte overrange(void);
+      // Returns true while the counter interrupt is turned off because the 
+      // input is too fast (or noisy) for the FCOVFBUDGET interrupt budget. 
+
+    byte present(void);
+      // Returns false after no input edges for FCPRESENCE mS (the counter is 
+      // idle), true when there is an input.  (Always true if FCPRESENCE is 0)
+
+    byte arm(struct FCGate *Buf, byte Gates);
+      // Capture the next 'Gates' ext gates (the first one that opens after 
+      // this call and the ones after it) into 'Buf', then stop.  Each gets 
+      // its raw count and its length (see gatetime).  Only in the ext gate 
+      // and timer gated modes.  Returns 0 if not in one of those modes (or 
+      // Gates is 0) else 1.  arm(0,0) stops a capture.  (Only if FCBURST)
+
+    byte captured(void);
+      // Returns the number of gates captured since arm().  The capture is 
+      // done when it equals 'Gates'.  (FreqCtrBurstFunc is called then too)
+
+    byte preset(unsigned long Count, byte Reload);
+      // Preset (batch) counter.  Count 'Count' input pulses, then on the last 
+      // one change the compare output pin (FCPRESETOUT) in hardware and call 
+      // FreqCtrPresetFunc.  If 'Reload' is non-zero the next batch starts 
+      // with the next pulse (none are lost), else the counter stops.  Stops 
+      // the frequency counter mode (mode() stops the preset counter). 
+      // preset(0,0) stops.  Returns 0 if FCPRESET is 0, else 1. 
+
+    unsigned long batches(void);
+      // Returns the number of batches done since preset().  available() is 
+      // true after each batch and false after calling this. 
+
+    byte trace(struct FCTraceEvent *Buf);
+      // Copy the trace events written since the last call (oldest first) to 
+      // 'Buf' and return the number copied.  'Buf' must hold FCTRACESIZE 
+      // events.  If more than that were written, only the newest are kept.
+      // (Only if FCTRACE is non-zero)
+
+    unsigned int tracelost(void);
+      // Returns the number of trace events that were written over before 
+      // they were read (65535 max) since the last call.  (Only if FCTRACE)
 };
 
 
@@ -100,6 +163,22 @@ extern void FreqCtrGateISR(void);
   // accurate timer) when FCGateTime is not zero. 
   // This is normally done in the ISR of one of the timers in the micro. 
 
+// If you define this function, then it will be called when the input signal 
+// goes away (Present=0, from the gate ISR) or comes back (Present=1, from 
+// the counter ISR).  (Only if FCPRESENCE is non-zero)
+extern "C" { extern void FreqCtrPresenceFunc(byte Present); }
+
+// If you define this function, then it will be called (from the ext gate 
+// ISR) when the last gate of a burst capture (FrequencyCounter::arm) is 
+// saved.  'Gates' is the number captured.  (Only if FCBURST is non-zero)
+extern "C" { extern void FreqCtrBurstFunc(byte Gates); }
+
+// If you define this function, then it will be called (from the counter 
+// compare ISR) at the end of each preset batch (FrequencyCounter::preset), 
+// right after the output pin changed.  'Batches' is the number done.  Keep 
+// it short if the next batch is short.  (Only if FCPRESET is non-zero)
+extern "C" { extern void FreqCtrPresetFunc(unsigned long Batches); }
+
 
 /******************************************************************************/
 /*                        User configurable options                           */
@@ -108,12 +187,98 @@ extern void FreqCtrGateISR(void);
 
 // Does this module take over the SysTimerIntFunc function ?
 #define FCINCLUDESYSTIMERLINK 1             // define as non-zero to take over function
+// (Gate edges are timed by the system timer compare unit B if SYSTIMERGATE 
+//  is defined as non-zero in systimer.h)
+// (If SYSTIMERWHEEL is non-zero, a timer on the wheel is used instead and 
+//  SysTimerIntFunc is left for the user)
+
+// Use the hand coded counter overflow ISR?  It saves only one register and 
+// takes about half the CPU cycles of the C version.  This matters at high 
+// input frequencies (31250 interrupts/sec at 8MHz with Timer0).
+#define FCFASTOVF             0             // 1= use hand coded overflow ISR
+// To measure it with a scope, pulse this PORTB bit high while it runs. 
+#define FCFASTOVFSCOPE        -1            // -1= off, 0..7= PORTB bit (PB0..PB7)
+
+// Timer used to count the input.  A 16 bit timer interrupts 256 times less 
+// often than Timer0, so use one where the input pin is on the board. 
+//   ATmega32U4: 0= Timer0 (D6), 1= Timer1 (D12 [PD6], Leonardo, not on the 
+//               Pro Micro, requires SYSTIMERNO 3)
+//   ATmega328P: 0= Timer0 (D4), 1= Timer1 (D5, requires SYSTIMERNO 2)
+//   ATmega2560: 0= Timer0 (D38), 5= Timer5 (D47, SYSTIMERNO not 5)
+#if defined(__AVR_ATmega328P__) || defined(__AVR_ATmega168__)
+#define FCCOUNTTIMER          1             // Timer1 (D5)
+#elif defined(__AVR_ATmega2560__) || defined(__AVR_ATmega1280__)
+#define FCCOUNTTIMER          5             // Timer5 (D47)
+#else
+#define FCCOUNTTIMER          0             // 0= Timer0 (D6), 1= Timer1 (D12)
+#endif
+
+// Count a second input on Timer1 (D12 [PD6] Leonardo, D5 Uno) at the same 
+// time as the Timer0 input, with the same gate.  Read it with read2.  
+// Requires FCCOUNTTIMER 0, the system timer not on Timer1 and FCTIMERGATE 0 
+// (Timer1 is the gate timer).  Not in the period modes. 
+#define FCCHANNEL2            0             // 1= second counter on Timer1
 
 // Allow Ext Gate mode?       (adds 244 flash bytes )
 #define FCEXTERN              1             // 1= ext gate mode enabled
 
 // Arduino pin number to use for external gate
-#define FCEXTGATEMSK          PCINTMASK9    // PB5 isr index (Arduino Digital 9)
+#define FCEXTGATEMSK          PCINTMASK9    // PB5 isr index (Digital 9, Uno D13, Mega D11)
+
+// Use an external interrupt pin (INT0..INT3) as the ext gate input instead 
+// of the pin change interrupt?  -1= pin change (FCEXTGATEMSK), 0..3= INTn. 
+// INT0 is D3 [PD0], INT1 is D2 [PD1], INT2 is D0 [PD2], INT3 is D1 [PD3] 
+// (INT2/INT3 are the Serial1 RX/TX pins).  ATmega2560: INT0..3 are D21, 
+// D20, D19, D18.  ATmega328P: only INT0 (D2) and INT1 (D3). 
+// Its ISR starts/stops the counter in its first few instructions, so the 
+// gate length is the same as the gate signal to within a cycle or two. 
+#define FCEXTGATEINT          -1            // -1= pin change, 0..3= INT0..3
+
+// Measure the length of each ext gate (mode 6) with the system timer so the 
+// string read() returns the frequency instead of the raw count?
+// The gate must be shorter than one 32 bit time stamp wrap (67S with 
+// SYSTIMERPLLTS, 268S with 62.5nS system timer ticks, longer with slower ones).
+#define FCEXTTIME             1             // 1= measure ext gate length
+
+// Allow burst capture of ext gates (FrequencyCounter::arm)?
+#define FCBURST               1             // 1= arm/captured available
+
+// One captured ext gate (FrequencyCounter::arm)
+typedef struct FCGate {
+  unsigned long count;                      // raw count (not prescaled)
+  unsigned long len;                        // gate length (ticks, see gatetime)
+} FCGate;
+
+// Allow timer gated modes?  Timer3 output on D5 is the gate signal and must 
+// be connected to the ext gate pin.  (requires FCEXTERN, ATmega32U4 only)
+#if defined(__AVR_ATmega32U4__) || defined(__AVR_ATmega16U4__)
+#define FCTIMERGATE           1             // 1= timer gated modes enabled
+#else
+#define FCTIMERGATE           0             // (ATmega32U4 only)
+#endif
+
+// Limit the counter interrupts (count mode overflows, period mode periods) 
+// to this many per second (0= no limit).  If there are more in a 10mS 
+// interval, the counter interrupt is turned off and the reading is 
+// FCOVERRANGE until the input is back in range (checked every 100mS).  This 
+// keeps a noisy or too fast input from using up the CPU.  (e.g. 20000)
+// (Not with SYSTIMERTICKLESS)
+#define FCOVFBUDGET           0             // interrupts/sec (0= no limit)
+#define FCOVERRANGE           0xFFFFFFFFUL  // read() value when over range
+
+// If non-zero, then after no input edges for this many mS the input is 
+// "absent" and the counter goes idle: it stops publishing readings (one 0 
+// reading is published when it goes absent), the gate edge and period 
+// timeout work stop and nothing is polled.  One counter interrupt is left 
+// armed (a compare match on the next count, or the period edge) and the 
+// first edge restarts the measurement.  The 1mS system timer tick keeps 
+// running for millis().  Not used in the ext gate / timer gated modes.  
+// (Not with SYSTIMERTICKLESS)
+#define FCPRESENCE            0             // mS (0= always present)
+
+// mS between gates in the timer gated modes (gate off time).  1..48 at 16MHz 
+// (the 1S gate plus this must fit the 16 bit gate timer). 
+#define FCTGDEAD              1            
 
 // Allow period measure mode? (adds 1030 flash bytes)
 #define FCPERIOD              1             // 1= Period measure mode enabled
@@ -121,12 +286,68 @@ extern void FreqCtrGateISR(void);
 // for period measure it must occur within this many mS
 #define PERIODTIMOUT          5000          
 
+// Count the edges of each period with the counter in CTC mode (OCRxA= 
+// averages-1) and take the time stamp in the compare match ISR?  The timer 
+// clears itself on the last edge, so no edges are lost reloading it in the 
+// ISR and the averaged period modes work to much higher input frequencies. 
+// 0= the old way (counter loaded with -averages, overflow ISR reloads it).
+#define FCPRDCTC              1             // 1= period edges counted in CTC mode
+
+// Allow the preset (batch) counter (FrequencyCounter::preset)?  The counter 
+// runs in CTC mode.  A batch longer than the counter (256 counts for Timer0) 
+// is split into segments of 128..256 counts.  The compare B ISR loads each 
+// segment's length in the middle of it (never while the counter is at the 
+// match), so the end of the batch is exact and the output changes on the 
+// Nth pulse with no software delay.  (Uses both compare units of the timer)
+#define FCPRESET              0             // 1= preset counter available
+
+// Drive the counter's compare output pin (OCxA) in preset mode?  It toggles 
+// at the end of each batch (starts low).  ATmega32U4: D11 (Timer0), D9 
+// (Timer1).  ATmega328P: D6 (Timer0), D9 (Timer1).  ATmega2560: D13 (Timer0), 
+// D46 (Timer5). 
+#define FCPRESETOUT           1             // 1= toggle the OCxA pin
+
 // If there is a prescaler, put prescale value here
 #define FCPRESCALER           1             
 
 // Enable this for debug messages.
 //#define FRQCTRDEBUG           1             // For debug... show debug messages. 
 
+// Keep a trace of the counter events (gate edges, ready, read, etc.) in RAM?  
+// Each event takes about 30 CPU cycles and 4 bytes.  (See FrequencyCounter::trace)
+#define FCTRACE               0             // 1= trace enabled
+#define FCTRACESIZE           64            // events kept (power of 2, max 128)
+// Also trace each counter overflow?  (Fills the trace quickly at high input 
+// frequencies.  Not traced with FCFASTOVF)
+#define FCTRACEOVF            0             // 1= trace overflows too
+
+// Trace event types ('data' is the low byte of the value shown)
+#define FCEV_GATEOPEN         1             // ext gate opened (count started)
+#define FCEV_GATECLOSE        2             // gate closed, count latched (count)
+#define FCEV_OVF              3             // counter overflow (overflow count)
+#define FCEV_MODE             4             // mode() changed the mode (new mode)
+#define FCEV_READY            5             // new value ready (value)
+#define FCEV_READ             6             // value read by read() (1=waited)
+#define FCEV_PCLOW            7             // ext gate pin went low (PCINT bit)
+#define FCEV_PCHIGH           8             // ext gate pin went high (PCINT bit)
+#define FCEV_PERIOD           9             // period measured (low byte of time)
+#define FCEV_ARM              10            // gate edge armed (SYSTIMERGATE)
+#define FCEV_TIMEOUT          11            // period measure timed out
+#define FCEV_OVERRANGE        12            // too many interrupts (in 10mS)
+#define FCEV_ABSENT           13            // input signal went away
+#define FCEV_PRESENT          14            // input signal came back
+#define FCEV_BURST            15            // burst capture done (gates)
+#define FCEV_PRESET           16            // preset batch done (batches)
+
+// One trace event.  'time' is the system timer count (SYSTIMERTCNT) when the 
+// event happened.  It clears every system timer period (1mS, or longer with 
+// SYSTIMERTICKLESS) so it only orders events that are close together.
+typedef struct FCTraceEvent {
+  byte type;                                // FCEV_xxx
+  byte data;                                // depends on type (see above)
+  unsigned int time;                        // system timer count
+} FCTraceEvent;
+
 
 #endif    // _FREQCTR_H
 
@@ -0,0 +1,257 @@
+/******************************************************************************/
+/*                                                                            */
+/*           ISRStats -- Interrupt service routine time statistics            */
+/*                                                                            */
+/*             Copyright (c) 2026  FrequencyCounter contributors              */
+/*                                                                            */
+/* Permission is hereby granted, free of charge, to any person obtaining a    */
+/* copy of this software and associated documentation files (the "Software"), */
+/* to deal in the Software without restriction, including without limitation  */
+/* the rights to use, copy, modify, merge, publish, distribute, sublicense,   */
+/* and/or sell copies of the Software, and to permit persons to whom the      */
+/* Software is furnished to do so, subject to the following conditions:       */
+/*                                                                            */
+/* The above copyright notice and this permission notice shall be included in */
+/* all copies or substantial portions of the Software.                        */
+/*                                                                            */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    */
+/* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING    */
+/* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER        */
+/* DEALINGS IN THE SOFTWARE.                                                  */
+/*                                                                            */
+/*  PROCESSOR:  ATmega32U4       COMPILER: Arduino/GNU C for AVR Vers 1.8.5   */ 
+/*  Written by: FrequencyCounter contributors 2026                            */ 
+/*                                                                            */
+/******************************************************************************/
+
+/*
+
+  This module measures how long the interrupt service routines take and how 
+  late they start.  Each measured ISR reads the system timer count (TCNT1 or 
+  TCNT3) when it starts (ISRSTAT_ENTER) and again when it ends (ISRSTAT_EXIT).
+  For each ISR the number of times it ran, the total (for the mean) and 
+  longest time, and a histogram of the times are kept.  The histogram bins 
+  double in size (0, 1, 2..3, 4..7 ... ticks) so a few bytes cover everything 
+  from a few uS to over a mS.
+  
+  For ISRs that are started by the system timer (the 1mS interrupt and the 
+  compare B gate edge) the timer count when the interrupt was requested is 
+  known, so the entry latency (how long it was held off by other ISRs, USB, 
+  etc.) is kept the same way.  
+  
+  The times are in system timer ticks (4uS at 16MHz and /64).  Use a faster 
+  system timer prescale (TIMERPSVALUE in systimer.h) for finer times.  
+  Times over one timer period (1mS) are not measured correctly. 
+  
+  Define "ISRSTATS" as non-zero in the header file to turn the measurements 
+  on.  When it is zero no code or RAM is used.  The hand coded counter 
+  overflow ISR (FCFASTOVF) is not measured. 
+  
+  Use ISRStatGet to get the statistics for an ISR and ISRStatClear to start 
+  over.  The example programs show them with the 'I' command. 
+  
+  If "ISRLOAD" is also non-zero, the time in each ISR is added up for the CPU 
+  load too.  The one second window is split into ISRLOADSLOTS parts.  The 
+  system timer ISR closes a part every 1000/ISRLOADSLOTS mS and the oldest 
+  part drops out, so the window slides.  The idle time is measured from 
+  ISRLOAD_IDLEBEGIN to ISRLOAD_IDLEEND (delay and the wait in 
+  FrequencyCounter::read) less the time in the ISRs that ran while idle.  
+  An ISR that runs inside another measured one (FreqCtrGateISR is called by 
+  the system timer ISR) is only counted for itself, not in the outer one too. 
+  Whatever is left is the main loop.  This shows how much of the CPU the 
+  counter overflow ISR takes at high input frequencies.  The example 
+  programs show it with the 'L' command. 
+
+*/
+
+/* 
+Revision log: 
+  1.0.0    10-16-26  contrib   
+    Initial implementation
+  1.0.1    10-16-26  contrib   
+    Added CPU load meter (ISRLOAD)
+
+*/
+
+#include <arduino.h>
+#include "ISRStats.h"
+
+#if ISRSTATS
+
+#if !SYSTIMERINCLUDESDELAY
+#error "ISRSTATS uses the system timer count (needs SYSTIMERINCLUDESDELAY)"
+#endif
+
+static ISRStat ISRStats[ISRIDS];
+volatile unsigned int ISRStatNested;          // time in measured ISRs (rolls over)
+
+#if ISRLOAD
+#if SYSTIMERTICKLESS
+#error "ISRLOAD needs the 1mS system timer tick (not SYSTIMERTICKLESS)"
+#endif
+
+#define LOADIDLE    ISRIDS                    // index of idle time in sums
+#define LOADSLOTMS  (1000/ISRLOADSLOTS)       // mS in each part of the window
+
+static unsigned long LoadCur[ISRIDS+1];       // ticks in the part being added 
+static unsigned long LoadIdleISR;             // ticks in ISRs while idle
+static unsigned long LoadSlot[ISRLOADSLOTS][ISRIDS+1]; // the finished parts
+static byte LoadSlotNo;                       // next part to write
+static byte LoadSlots;                        // number of finished parts
+static unsigned int LoadMs;                   // mS in the part being added
+static byte LoadIdling;                       // nested idle count (0=busy)
+static unsigned int LoadIdleStart;            // timer count when idle started
+#endif
+
+
+static byte ISRStatBin(unsigned int t)
+  // Return the histogram bin for time 't'.  (The number of bits in 't')
+{
+  byte b=0;
+  if (t>=256) { t>>=8; b=8; }
+  while (t) { t>>=1; b++; }
+  return (b<ISRSTATBINS) ? b : ISRSTATBINS-1;
+}
+
+
+static unsigned int ISRStatDiff(unsigned int From, unsigned int To)
+  // Return the number of ticks from timer count 'From' to 'To'.  (The timer 
+  // clears every SYSTIMERPERIOD ticks)
+{
+  if (To < From) To += SYSTIMERPERIOD;
+  return To-From;
+}
+
+
+void ISRStatTime(byte id, unsigned int Start, unsigned int Nested)
+  // Add the time from 'Start' (timer count) to now to the ISR's statistics.
+  // The ISRs that ran inside this one added their time to ISRStatNested 
+  // since 'Nested' was read, so that part is left out of the CPU load. 
+  // (Interrupts may be on, e.g. at the end of FreqCtrGateISR)
+{
+  ISRStat *s = &ISRStats[id];
+  unsigned int t, in;
+  byte b;
+  uint8_t oldSREG = SREG;
+  cli();
+  t = ISRStatDiff(Start,SYSTIMERTCNT);
+  in = ISRStatNested-Nested;                      // time in nested ISRs
+  ISRStatNested = Nested+t;                       // (for an enclosing ISR)
+  b = ISRStatBin(t);
+  s->count++;  s->sum += t;
+  if (t > s->max) s->max = t;
+  if (s->hist[b] != 0xFFFF) s->hist[b]++;         // (don't roll over)
+#if ISRLOAD
+  t = (t > in) ? t-in : 0;                        // only this ISR's own time
+  LoadCur[id] += t;
+  if (LoadIdling) LoadIdleISR += t;
+#else
+  (void)in;
+#endif
+  SREG = oldSREG;
+}
+
+
+void ISRStatLatency(byte id, unsigned int Start, unsigned int Due)
+  // Add the time from 'Due' to 'Start' to the ISR's entry latency statistics. 
+{
+  ISRStat *s = &ISRStats[id];
+  unsigned int t = ISRStatDiff(Due,Start);
+  byte b = ISRStatBin(t);
+  s->latcount++;  s->latsum += t;
+  if (t > s->latmax) s->latmax = t;
+  if (s->lathist[b] != 0xFFFF) s->lathist[b]++;
+}
+
+
+void ISRStatGet(byte id, ISRStat *st)
+  // Copy the statistics for ISR 'id' to 'st'. 
+{
+  uint8_t oldSREG = SREG;
+  if (id >= ISRIDS) { memset(st,0,sizeof(ISRStat)); return; }
+  cli();  *st = ISRStats[id];  SREG = oldSREG;
+}
+
+
+void ISRStatClear(void)
+  // Clear the statistics for all of the ISRs.
+{
+  uint8_t oldSREG = SREG;
+  cli();  memset(ISRStats,0,sizeof(ISRStats));  SREG = oldSREG;
+}
+
+
+#if ISRLOAD
+
+void ISRLoadIdleBegin(void)
+  // The main loop starts waiting.  (Time from now on counts as idle)
+{
+  uint8_t oldSREG = SREG;
+  cli();  
+  if (!LoadIdling++) LoadIdleStart = SYSTIMERTCNT;
+  SREG = oldSREG;
+}
+
+
+void ISRLoadIdleEnd(void)
+  // The main loop is done waiting.
+{
+  uint8_t oldSREG = SREG;
+  cli();  
+  if (LoadIdling && !--LoadIdling) 
+    LoadCur[LOADIDLE] += ISRStatDiff(LoadIdleStart,SYSTIMERTCNT);
+  SREG = oldSREG;
+}
+
+
+void ISRLoadTick(void)
+  // Account the mS just finished.  (Called from the system timer ISR)
+{
+  byte i;
+  if (LoadIdling)           // idle up to the timer clear, then from 0 again
+  { 
+    LoadCur[LOADIDLE] += SYSTIMERPERIOD-LoadIdleStart;  
+    LoadIdleStart = 0; 
+  }
+  if (++LoadMs < LOADSLOTMS) return;
+  // Part done.  Idle is the time waiting less the ISRs that ran while waiting
+  LoadMs = 0;
+  if (LoadCur[LOADIDLE] > LoadIdleISR) LoadCur[LOADIDLE] -= LoadIdleISR;
+  else LoadCur[LOADIDLE] = 0;
+  for (i=0; i<=ISRIDS; i++) { LoadSlot[LoadSlotNo][i]=LoadCur[i]; LoadCur[i]=0; }
+  LoadIdleISR = 0;
+  if (++LoadSlotNo >= ISRLOADSLOTS) LoadSlotNo = 0;
+  if (LoadSlots < ISRLOADSLOTS) LoadSlots++;
+}
+
+
+void ISRLoadGet(ISRLoad *ld)
+  // Copy the CPU load over the last second to 'ld'.  
+{
+  unsigned long Sum[ISRIDS+1], Total;
+  unsigned int Used=0;
+  byte i,j,n;
+  uint8_t oldSREG = SREG;
+  memset(ld,0,sizeof(ISRLoad));
+  cli();  
+  n = LoadSlots;
+  for (i=0; i<=ISRIDS; i++) 
+    for (Sum[i]=0, j=0; j<n; j++) Sum[i] += LoadSlot[j][i];
+  SREG = oldSREG;
+  if (!n) return;
+  // Tenths of a percent.  Sum*1000/Total would overflow at the faster 
+  // prescales, so it is Sum*8/(Total/125).  (Total/125 is exact, LOADSLOTMS 
+  // times the number of parts is a multiple of 125 mS)
+  Total = (unsigned long)n*LOADSLOTMS*SYSTIMERTICKS/125;
+  for (i=0; i<ISRIDS; i++) { ld->isr[i] = Sum[i]*8/Total;  Used += ld->isr[i]; }
+  ld->idle = Sum[LOADIDLE]*8/Total;  Used += ld->idle;
+  ld->main = (Used < 1000) ? 1000-Used : 0;
+}
+
+#endif  // ISRLOAD
+
+#endif  // ISRSTATS
+
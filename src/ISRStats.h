@@ -0,0 +1,159 @@
+/******************************************************************************/
+/*                                                                            */
+/*           ISRStats -- Interrupt service routine time statistics            */
+/*                                                                            */
+/*             Copyright (c) 2026  FrequencyCounter contributors              */
+/*                                                                            */
+/* Permission is hereby granted, free of charge, to any person obtaining a    */
+/* copy of this software and associated documentation files (the "Software"), */
+/* to deal in the Software without restriction, including without limitation  */
+/* the rights to use, copy, modify, merge, publish, distribute, sublicense,   */
+/* and/or sell copies of the Software, and to permit persons to whom the      */
+/* Software is furnished to do so, subject to the following conditions:       */
+/*                                                                            */
+/* The above copyright notice and this permission notice shall be included in */
+/* all copies or substantial portions of the Software.                        */
+/*                                                                            */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    */
+/* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING    */
+/* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER        */
+/* DEALINGS IN THE SOFTWARE.                                                  */
+/*                                                                            */
+/*  PROCESSOR:  ATmega32U4       COMPILER: Arduino/GNU C for AVR Vers 1.8.5   */ 
+/*  Written by: FrequencyCounter contributors 2026                            */ 
+/*                                                                            */
+/******************************************************************************/
+
+// See .cpp file for a description of this module and it's functions.
+
+#ifndef _ISRSTATS_H
+#define _ISRSTATS_H
+
+#include <arduino.h>
+#include "systimer.h"
+
+// If non-zero then the ISRs below are measured.  If zero, the ISRSTAT_ 
+// macros don't generate any code. 
+#define ISRSTATS            0
+
+// ISRs (or ISR functions) that are measured
+#define ISRID_SYSTIMER      0   // system timer ISR (each mS)
+#define ISRID_GATE          1   // FreqCtrGateISR (each 10mS)
+#define ISRID_CTROVF        2   // frequency counter overflow ISR (not FCFASTOVF)
+#define ISRID_PCINT         3   // pin change / ext interrupt 6 ISR
+#define ISRID_GATEEDGE      4   // system timer compare B ISR (SYSTIMERGATE)
+#define ISRIDS              5   // number of ISRs measured
+
+// Number of histogram bins.  Bin 0 is 0 ticks, bin 1 is 1 tick, bin 2 is 
+// 2..3 ticks, bin 3 is 4..7 ticks... and the last bin is everything longer.
+#define ISRSTATBINS         10
+
+// If non-zero (and ISRSTATS) then also keep the CPU load: the part of the 
+// time spent in each of the ISRs above, idle (waiting in delay or 
+// FrequencyCounter::read) and in the main loop, over the last second. 
+// (Needs the 1mS system timer tick, so not with SYSTIMERTICKLESS)
+#define ISRLOAD             1
+// The one second window slides in this many steps (1, 2, 4 or 8)
+#define ISRLOADSLOTS        4
+
+// Statistics for one ISR.  All times are in system timer ticks 
+// (SYSTIMERTICKSPERSEC per second, 4uS at 16MHz and /64)
+typedef struct {
+  unsigned long count;              // number of times the ISR ran
+  unsigned long sum;                // total time in the ISR (sum/count=mean)
+  unsigned int  max;                // longest time in the ISR
+  unsigned int  hist[ISRSTATBINS];  // log2 histogram of the time in the ISR
+  unsigned long latcount;           // number of entry latencies measured
+  unsigned long latsum;             // total entry latency 
+  unsigned int  latmax;             // longest entry latency
+  unsigned int  lathist[ISRSTATBINS];// log2 histogram of the entry latency
+} ISRStat;
+
+// CPU load over the last second, in tenths of a percent (0..1000). 
+// The time in ISRs that aren't measured (USB, FCFASTOVF) is counted as 
+// idle or main.
+typedef struct {
+  unsigned int isr[ISRIDS];         // time in each ISR 
+  unsigned int idle;                // time waiting (less the ISRs)
+  unsigned int main;                // the rest (main loop)
+} ISRLoad;
+
+#if ISRSTATS
+
+// Put ISRSTAT_ENTER() at the start of the ISR and ISRSTAT_EXIT(id) at the 
+// end.  Use ISRSTAT_ENTERAT(id,Due) instead of ISRSTAT_ENTER if the timer 
+// count when the interrupt was requested (Due) is known (e.g. the compare 
+// value), so the entry latency is measured too.  (The latency includes the 
+// ISR prologue) 
+// Measured ISRs may be nested (FreqCtrGateISR is called by the system timer 
+// ISR, and the counter ISRs can run while it has interrupts on).  The 
+// statistics are the whole time, but the CPU load only counts the time 
+// that wasn't in a nested measured ISR, so no time is counted twice. 
+#define ISRSTAT_ENTER()         unsigned int _ISRStatT=SYSTIMERTCNT; \
+                                unsigned int _ISRStatN=ISRStatNested
+#define ISRSTAT_ENTERAT(id,Due) ISRSTAT_ENTER(); \
+                                ISRStatLatency(id,_ISRStatT,Due)
+#define ISRSTAT_EXIT(id)        ISRStatTime(id,_ISRStatT,_ISRStatN)
+
+extern volatile unsigned int ISRStatNested;
+// Total time in the measured ISRs so far (rolls over).  (Used by the macros)
+
+extern void ISRStatTime(byte id, unsigned int Start, unsigned int Nested);
+// Add the time from 'Start' (timer count) to now to the ISR's statistics.
+// 'Nested' is ISRStatNested at the start.  (Used by ISRSTAT_EXIT)
+
+extern void ISRStatLatency(byte id, unsigned int Start, unsigned int Due);
+// Add the time from 'Due' to 'Start' to the ISR's entry latency statistics. 
+// (Used by ISRSTAT_ENTERAT.  Call with interrupts off)
+
+extern void ISRStatGet(byte id, ISRStat *st);
+// Copy the statistics for ISR 'id' to 'st'. 
+
+extern void ISRStatClear(void);
+// Clear the statistics for all of the ISRs.
+
+#endif  // ISRSTATS
+
+#if ISRSTATS && ISRLOAD
+
+// Put ISRLOAD_IDLEBEGIN() before and ISRLOAD_IDLEEND() after code that just 
+// waits (e.g. "while (!ready) yield();").  They may be nested.  ISRLOAD_TICK() 
+// is called by the system timer ISR each mS. 
+#define ISRLOAD_IDLEBEGIN()     ISRLoadIdleBegin()
+#define ISRLOAD_IDLEEND()       ISRLoadIdleEnd()
+#define ISRLOAD_TICK()          ISRLoadTick()
+
+extern void ISRLoadIdleBegin(void);
+// The main loop starts waiting.  (Time from now on counts as idle)
+
+extern void ISRLoadIdleEnd(void);
+// The main loop is done waiting.
+
+extern void ISRLoadTick(void);
+// Account the mS just finished.  (Called from the system timer ISR)
+
+extern void ISRLoadGet(ISRLoad *ld);
+// Copy the CPU load over the last second to 'ld'.  (Until the first 
+// 1000/ISRLOADSLOTS mS have passed, everything is 0)
+
+#else
+
+#define ISRLOAD_IDLEBEGIN()
+#define ISRLOAD_IDLEEND()
+#define ISRLOAD_TICK()
+
+#endif  // ISRSTATS && ISRLOAD
+
+#if !ISRSTATS
+
+#define ISRSTAT_ENTER()
+#define ISRSTAT_ENTERAT(id,Due)
+#define ISRSTAT_EXIT(id)
+
+#endif  // !ISRSTATS
+
+#endif  // _ISRSTATS_H
+
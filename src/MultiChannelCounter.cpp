@@ -0,0 +1,213 @@
+/******************************************************************************/
+/*                                                                            */
+/*         MultiChannelCounter -- Multi channel low frequency counter         */
+/*                                                                            */
+/*             Copyright (c) 2026  FrequencyCounter contributors              */
+/*                                                                            */
+/* Permission is hereby granted, free of charge, to any person obtaining a    */
+/* copy of this software and associated documentation files (the "Software"), */
+/* to deal in the Software without restriction, including without limitation  */
+/* the rights to use, copy, modify, merge, publish, distribute, sublicense,   */
+/* and/or sell copies of the Software, and to permit persons to whom the      */
+/* Software is furnished to do so, subject to the following conditions:       */
+/*                                                                            */
+/* The above copyright notice and this permission notice shall be included in */
+/* all copies or substantial portions of the Software.                        */
+/*                                                                            */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    */
+/* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING    */
+/* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER        */
+/* DEALINGS IN THE SOFTWARE.                                                  */
+/*                                                                            */
+/*  PROCESSOR:  ATmega32U4       COMPILER: Arduino/GNU C for AVR Vers 1.8.5   */ 
+/*  Written by: FrequencyCounter contributors 2026                            */ 
+/*                                                                            */
+/******************************************************************************/
+
+/*
+
+  This module counts up to eight low frequency signals (tach, flow meters, 
+  etc. up to a few kHz) at the same time on the pin change pins PB0..PB6 and 
+  INT6.  The single hardware counter (FrequencyCounter) is not needed. 
+
+  A function is attached (PCInterrupt::attach) to the rising edge of each 
+  channel's pin.  It stamps the edge with the system timer (ticks32, 4uS at 
+  16MHz) and counts it.  When the first edge after the channel's gate time 
+  comes (or the number of periods set by 'average'), the number of periods 
+  and the time from the first edge to this one are latched as the reading 
+  and the next gate starts on this edge.  This is reciprocal counting, so the 
+  resolution is the timer tick and not one count, even at a few Hz.  All of 
+  the channels use the same time base. 
+
+  The pin change ISR only calls the functions of the pins that changed, and 
+  each function does the same (short) work, so the ISR time for an edge does 
+  not depend on how many channels are counting.  Each channel has its own 
+  gate time and averaging. 
+
+  'snapshot' copies the readings of all of the channels at once (with the 
+  interrupts off) so they belong together.  A channel with no edges for its 
+  gate time plus MCCTIMEOUT reads 0Hz. 
+
+  The pin change pins are shared with the ext gate (FCEXTGATEMSK) of the 
+  frequency counter, so don't count on that pin when using the ext gate. 
+
+*/
+
+/* 
+Revision log: 
+  1.0.0    10-16-26  contrib   
+    Initial implementation
+
+*/
+
+#include <arduino.h>
+#include "MultiChannelCounter.h"
+#include "systimer.h"           // ticks32 (time stamps)
+
+#ifndef MCCGATE
+#define MCCGATE         1000
+#endif
+#ifndef MCCTIMEOUT
+#define MCCTIMEOUT      1000
+#endif
+
+// Time base for the edge time stamps.  The system timer ticks if we have 
+// them, else micros(). 
+#if SYSTIMERINCLUDESDELAY
+#define MCCTIME()       ticks32()
+#define MCCTPS          SYSTIMERTICKSPERSEC // MCCTIME counts per second
+#else
+#define MCCTIME()       micros()
+#define MCCTPS          1000000L
+#endif
+#define MCCMSTICKS      (MCCTPS/1000)       // MCCTIME counts per mS
+
+// The state of each channel (written by the pin change ISR)
+struct MCCChannel {
+  unsigned long first;      // time of the edge that started this gate
+  unsigned long last;       // time of the last edge
+  unsigned long gate;       // gate time (ticks)
+  unsigned int  avg;        // end the gate after this many periods
+  unsigned int  cnt;        // periods in this gate so far
+  unsigned long count;      // edges since begin
+  unsigned int  periods;    // the last reading (periods)
+  unsigned long ticks;      //   and (time) 
+  byte          started;    // non-zero after the first edge
+};
+static struct MCCChannel mcc[MCCCHANNELS];
+static byte mccOn = 0;                // channels that are counting
+volatile static byte mccReady = 0;    // channels with a new reading
+
+
+static void __attribute__((noinline)) MCCEdge(byte n)
+  // Rising edge on channel 'n'.  Called from the pin change ISR.
+{
+  unsigned long t = MCCTIME();
+  struct MCCChannel *c = &mcc[n];
+  c->count++;  c->last = t;
+  if (!c->started) { c->first = t;  c->cnt = 0;  c->started = 1;  return; }
+  c->cnt++;
+  if ((t - c->first) >= c->gate || c->cnt == c->avg)  // end of the gate
+  {
+    c->periods = c->cnt;  c->ticks = t - c->first;
+    c->first = t;  c->cnt = 0;          // next gate starts on this edge
+    mccReady |= (1<<n);
+  }
+}
+
+// One function per pin for PCInterrupt::attach (it doesn't pass the pin)
+#define MCCEDGEFUNC(n)  static void MCCEdge##n(byte Rising __attribute__((unused))) { MCCEdge(n); }
+MCCEDGEFUNC(0)  MCCEDGEFUNC(1)  MCCEDGEFUNC(2)  MCCEDGEFUNC(3)
+MCCEDGEFUNC(4)  MCCEDGEFUNC(5)  MCCEDGEFUNC(6)  MCCEDGEFUNC(7)
+static const PCPinFunc MCCFuncs[MCCCHANNELS] = 
+  { MCCEdge0, MCCEdge1, MCCEdge2, MCCEdge3, MCCEdge4, MCCEdge5, MCCEdge6, MCCEdge7 };
+
+
+/******************************************************************************/
+/*                 MultiChannelCounter Class functions                        */
+/*                        (Main user interface)                               */
+/*                                                                            */
+/******************************************************************************/
+
+void MultiChannelCounter::begin(byte mask)
+  // Start counting the rising edges on the pins in 'mask'. 
+{
+  byte n;
+  mask &= ~mccOn;                       // (the ones already counting keep going)
+  if (!mask) return;
+  PCH.disable(mask);
+  for (n=0; n<MCCCHANNELS; n++) 
+  {
+    if (!(mask & (1<<n))) continue;
+    memset(&mcc[n],0,sizeof(mcc[n]));
+    mcc[n].gate = MCCGATE*MCCMSTICKS;  mcc[n].avg = 0xFFFF;
+    PCH.attach(1<<n,PCRISING,MCCFuncs[n]);
+  }
+  mccReady &= ~mask;  mccOn |= mask;
+  PCH.enable(mask);
+}
+
+void MultiChannelCounter::end(byte mask)
+  // Stop counting on the pins in 'mask'. 
+{
+  mask &= mccOn;
+  if (!mask) return;
+  PCH.disable(mask);  PCH.detach(mask);
+  mccOn &= ~mask;  mccReady &= ~mask;
+}
+
+void MultiChannelCounter::gate(byte mask, unsigned int ms)
+  // Set the gate time (mS) of the channels in 'mask'. 
+{
+  byte n;
+  if (!ms) ms=1;
+  noInterrupts();
+  for (n=0; n<MCCCHANNELS; n++) 
+    if (mask & (1<<n)) mcc[n].gate = (unsigned long)ms*MCCMSTICKS;
+  interrupts();
+}
+
+void MultiChannelCounter::average(byte mask, unsigned int periods)
+  // End the gate of the channels in 'mask' after 'periods' periods. (0=off)
+{
+  byte n;
+  if (!periods) periods=0xFFFF;         // (cnt can't go past this)
+  noInterrupts();
+  for (n=0; n<MCCCHANNELS; n++) 
+    if (mask & (1<<n)) mcc[n].avg = periods;
+  interrupts();
+}
+
+byte MultiChannelCounter::snapshot(struct MCCReading *r)
+  // Copy the last reading of all of the channels to r[MCCCHANNELS] at the 
+  // same time.  Returns the channels that have a new reading. 
+{
+  byte n, Ready;
+  struct MCCChannel *c;
+  unsigned long t;
+  noInterrupts();
+  t = MCCTIME();
+  for (n=0; n<MCCCHANNELS; n++, r++) 
+  {
+    c = &mcc[n];
+    if (!(mccOn & (1<<n))) { memset(r,0,sizeof(*r));  continue; }
+    // No edges for the gate time + timeout?  Then no signal, start over. 
+    if (c->started && (t - c->last) > c->gate + MCCTIMEOUT*MCCMSTICKS)
+      { c->started = 0;  c->periods = 0;  c->ticks = 0; }
+    r->periods = c->periods;  r->ticks = c->ticks;  r->count = c->count;
+  }
+  Ready = mccReady;  mccReady = 0;
+  interrupts();
+  return Ready;
+}
+
+unsigned long MultiChannelCounter::mhz(struct MCCReading *r)
+  // Returns the frequency of reading 'r' in mHz. (periods*MCCTPS*1000/ticks)
+{
+  if (!r->periods || !r->ticks) return 0;
+  return ((unsigned long long)r->periods*MCCTPS*1000 + (r->ticks>>1)) / r->ticks;
+}
+
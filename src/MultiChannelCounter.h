@@ -0,0 +1,89 @@
+/******************************************************************************/
+/*                                                                            */
+/*         MultiChannelCounter -- Multi channel low frequency counter         */
+/*                                                                            */
+/*             Copyright (c) 2026  FrequencyCounter contributors              */
+/*                                                                            */
+/* Permission is hereby granted, free of charge, to any person obtaining a    */
+/* copy of this software and associated documentation files (the "Software"), */
+/* to deal in the Software without restriction, including without limitation  */
+/* the rights to use, copy, modify, merge, publish, distribute, sublicense,   */
+/* and/or sell copies of the Software, and to permit persons to whom the      */
+/* Software is furnished to do so, subject to the following conditions:       */
+/*                                                                            */
+/* The above copyright notice and this permission notice shall be included in */
+/* all copies or substantial portions of the Software.                        */
+/*                                                                            */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    */
+/* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING    */
+/* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER        */
+/* DEALINGS IN THE SOFTWARE.                                                  */
+/*                                                                            */
+/*  PROCESSOR:  ATmega32U4       COMPILER: Arduino/GNU C for AVR Vers 1.8.5   */ 
+/*  Written by: FrequencyCounter contributors 2026                            */ 
+/*                                                                            */
+/******************************************************************************/
+
+// See .cpp file for a description of this module and it's functions.
+
+#ifndef _MULTICHANNELCOUNTER_H
+#define _MULTICHANNELCOUNTER_H
+
+#include <arduino.h>
+#include "PCInterrupt.h"
+
+// Channels are the pin change pins (PB0..PB6 and INT6).  Channel 'n' is the 
+// pin with bit 'n' set in its PCINTMASKxx constant, and the 'mask' values 
+// below are the same PCINTMASKxx constants (OR'ed for several channels). 
+#define MCCCHANNELS     8
+
+// Default gate time (mS) for each channel
+#define MCCGATE         1000
+
+// A channel reads 0Hz if it has had no edge for this many mS more than its 
+// gate time. 
+#define MCCTIMEOUT      1000
+
+// One channel's reading.  The frequency is periods/ticks (see mhz).  
+struct MCCReading {
+  unsigned int  periods;    // number of whole periods measured (0=no signal)
+  unsigned long ticks;      // the time of those periods (system timer ticks)
+  unsigned long count;      // rising edges counted since begin
+};
+
+class MultiChannelCounter
+{
+  public:
+    void begin(byte mask);
+      // Start counting the rising edges on the pins in 'mask'.  The pins are 
+      // set to inputs with pull up and their pin change interrupt is enabled. 
+      // Each channel measures the time from its first rising edge to the first 
+      // rising edge after its gate time, so the reading is a whole number of 
+      // periods (no +/-1 count error) and the next gate starts on the same 
+      // edge (no dead time). 
+
+    void end(byte mask);
+      // Stop counting on the pins in 'mask'. 
+
+    void gate(byte mask, unsigned int ms);
+      // Set the gate time (mS) of the channels in 'mask'.  (1..60000) 
+
+    void average(byte mask, unsigned int periods);
+      // End the gate of the channels in 'mask' after this many periods even if 
+      // the gate time hasn't passed.  0 = gate time only.  Use for faster 
+      // updates of the higher frequency channels. 
+
+    byte snapshot(struct MCCReading *r);
+      // Copy the last reading of all of the channels to r[MCCCHANNELS] at the 
+      // same time.  Returns the channels (mask) that have a new reading since 
+      // the last snapshot.  Channels that are not counting read all zeros. 
+
+    unsigned long mhz(struct MCCReading *r);
+      // Returns the frequency of a reading in mHz (0 if no signal) 
+};
+
+#endif  //_MULTICHANNELCOUNTER_H
+
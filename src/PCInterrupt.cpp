@@ -34,7 +34,8 @@
   sets bits in a variable that can either be checked via polled logic in some 
   mainline program or via a user written function that is called during the 
   actual pin change interrupt routine.  The pins include port B, bits 0 to 6, 
-  and external interrupt 6. 
+  and external interrupt 6.  (On the ATmega2560 bit 7 is PB7 instead of 
+  INT6, and on the ATmega328P there are only PB0..PB5.) 
   
   When using in the polled mode, three functions 'rising','falling' and 
   'change', can be used in mainline code to determine if the pin just 
@@ -53,6 +54,22 @@
 
   Pin change interupts are enabled/disabled via the enable and disable methods.
 
+  Several users (libraries) can share the pin change interrupt by attaching 
+  a function to their own pins with 'attach'.  The ISR only calls the 
+  functions for the pins that changed (on the edges asked for), finding them 
+  with a short bit scan, so one changed pin is one call.  Changes on pins 
+  with an attached function are not added to the changed bits or passed to 
+  PCChangeIntFunc, which is still called on every interrupt (only when a pin 
+  with no attached function changed if PCHOOKSKIP).  The function table is a fixed array (one entry per pin) 
+  so there is no memory allocation. 
+
+  With PCFIFO, each interrupt also puts the pins that changed, the state of 
+  the pins and a time stamp in a FIFO that mainline code drains with 'read'. 
+  The changed bits above only say that a pin went high or low at some time 
+  since the last 'clear'; the FIFO keeps every edge (until it fills) and when 
+  it happened, so several slow signals can be timed at once by polling.  If 
+  the FIFO is full the entry is dropped and counted ('lost'). 
+
   In all cases where a 'mask' variable is used, the user should use the 
   'PCINTMASKxx' constants found in the header file.  You can enable/disable 
   multiple pin change bits by OR'ing the mask constants to the enable/disable 
@@ -73,11 +90,51 @@ Revision log:
     Reworked to use ISR_ALIASOF and weak function instead of a function vector.
   1.0.1    6-20-21   REG   
     Reworked to use a class interface and added disable and change functions
+  1.0.2    10-16-26  contrib   
+    Added ISR time measurement (ISRStats module)
+  1.0.3    10-16-26  contrib   
+    Added per pin callback functions (attach/detach).  PCChangeIntFunc is 
+    only called for unattached pins if PCHOOKSKIP. 
+  1.0.4    10-16-26  contrib   
+    Added the time stamped edge FIFO (PCFIFO). 
+  1.0.5    10-16-26  contrib   
+    ATmega328P and ATmega2560 (PCPINS/PCREAD/PCENABLED per part). 
+  1.0.6    10-16-26  contrib   
+    Fixed disable turning off the other pins instead of the ones in 'mask'. 
 
 */
 
 #include <arduino.h>
 #include "pcinterrupt.h"
+#include "ISRStats.h"           // ISR time measurement (if ISRSTATS)
+#include "systimer.h"           // ticks32 (for the FIFO time stamp)
+
+#ifndef PCFIFO
+#define PCFIFO      0
+#endif
+#ifndef PCHOOKSKIP
+#define PCHOOKSKIP  0
+#endif
+
+// The pins on the pin change interrupt.  On the ATmega32U4 bit 7 is INT6 
+// [PE6] (PB7 has no pin on the Pro Micro), on the ATmega2560 it's PB7, and 
+// the ATmega328P has only PB0..PB5 (PB6/PB7 are the crystal).  PCREAD reads 
+// them and PCENABLED returns the ones that are enabled. 
+#if defined(__AVR_ATmega32U4__) || defined(__AVR_ATmega16U4__)
+#define PCHASINT6   1
+#define PCPINS      0x7F                  // pin change pins (PCMSK0 bits)
+#define PCREAD()    ((PINB&0x7f)|((PINE&0x40)<<1))
+#define PCENABLED() ((PCMSK0&0x7f)|((EIMSK<<1)&0x80))
+#else
+#define PCHASINT6   0
+#if defined(__AVR_ATmega328P__) || defined(__AVR_ATmega168__)
+#define PCPINS      0x3F
+#else
+#define PCPINS      0xFF
+#endif
+#define PCREAD()    (PINB&PCPINS)
+#define PCENABLED() (PCMSK0)
+#endif
 
 // This is the last state of the PC change pins
 volatile byte LastPINB = 0;
@@ -96,26 +153,95 @@ volatile byte Changes[2]= {0,0};
 extern "C" void __PCChangeISREmpty(byte Changes[] __attribute__((unused))) { }
 extern "C" void PCChangeIntFunc(byte Changes[]) __attribute__ ((weak, alias("__PCChangeISREmpty")));
 
+// Functions attached to each pin (bit number) and the pins that have one 
+// for the falling and the rising edge. 
+static PCPinFunc PCFuncs[8];
+static byte PCFallMask = 0;
+static byte PCRiseMask = 0;
+
+#if PCFIFO
+#if (PCFIFOSIZE & (PCFIFOSIZE-1)) || PCFIFOSIZE>128
+#error "PCFIFOSIZE must be a power of 2 (128 max)"
+#endif
+// Time base for the time stamps 
+#if SYSTIMERINCLUDESDELAY
+#define PCFIFOTIME()  ticks32()
+#else
+#define PCFIFOTIME()  micros()
+#endif
+// The FIFO.  The ISR writes at PCIn, mainline reads at PCOut.  (Each is only 
+// written by one side, so no interrupt disable is needed to read.) 
+static struct PCEdge PCFifo[PCFIFOSIZE];
+volatile static byte PCIn = 0;
+volatile static byte PCOut = 0;
+volatile static byte PCLost = 0;
+#endif
+
+static inline byte PCLowBit(byte b)
+  // Return the bit number of the lowest bit set in 'b' (b must not be 0)
+{
+  byte n=0;
+  if (!(b&0x0F)) { b>>=4; n=4; }
+  if (!(b&0x03)) { b>>=2; n+=2; }
+  if (!(b&0x01)) n++;
+  return n;
+}
+
 ISR(PCINT0_vect) 
 {
   // This routine called when the interrupt on change occurs on 
   // any of PB0..7.  The routine checks for each bit that changed,
   // and if it's now zero (falling) then call the routine specified.
   byte i, NewPINB;
+  ISRSTAT_ENTER();
 
-  NewPINB = (PINB&0x7f)|((PINE&0x40)<<1); // Read the IO ports
+  NewPINB = PCREAD();                     // Read the IO ports
   // i= changes to the bits that are enabled
-  i = ((LastPINB ^ NewPINB) & ((PCMSK0 &0x7f)|((EIMSK<<1)&0x80)));
-  Changes[0] |= i & ~NewPINB;             // pins that just went low
-  Changes[1]  |= i & NewPINB;             // pins that just went high
-  PCChangeIntFunc((byte *)Changes);
+  i = ((LastPINB ^ NewPINB) & PCENABLED());
+  if (i & (PCFallMask|PCRiseMask))        // call the attached functions 
+  {
+    byte b = (i & ~NewPINB & PCFallMask) | (i & NewPINB & PCRiseMask), n;
+    i &= ~(PCFallMask|PCRiseMask);        // (these pins are done)
+    while (b) 
+    { 
+      n = PCLowBit(b);  b &= b-1;         // next pin, and clear its bit
+      PCFuncs[n]((NewPINB>>n)&1); 
+    }
+  }
+#if PCFIFO
+  if (i)                                  // put the edges in the FIFO 
+  {
+    // Time stamp after the attached functions, so they (the frequency 
+    // counter gate) aren't held back by it.  (Later by their run time)
+    PCTime t = PCFIFOTIME();
+    byte n = PCIn;
+    if ((byte)(n-PCOut) >= (byte)PCFIFOSIZE) { if (PCLost<255) PCLost++; }
+    else 
+    {
+      struct PCEdge *e = &PCFifo[n & (PCFIFOSIZE-1)];
+      e->pins=i;  e->level=NewPINB;  e->time=t;
+      PCIn=n+1;
+    }
+  }
+#endif
+#if PCHOOKSKIP
+  if (i)                                  // pins left for the hook (not attached)
+#endif
+  {
+    Changes[0] |= i & ~NewPINB;           // pins that just went low
+    Changes[1] |= i & NewPINB;            // pins that just went high
+    PCChangeIntFunc((byte *)Changes);
+  }
   LastPINB=NewPINB;                       // Save  current state for next time.
+  ISRSTAT_EXIT(ISRID_PCINT);
 }
 
+#if PCHASINT6
 // Both the pin change and the external interrupt use the same ISR routine,
 //   so just point them both to the same routine.  Saves lots of code bytes!!
 ISR(INT6_vect, ISR_ALIASOF(PCINT0_vect));
   // This routine called when the external interrupt 6 occurs 
+#endif
 
 // These three functions return true if the pin change event occured. 
 boolean PCInterrupt::falling(byte mask)  { return(Changes[0] & mask); } 
@@ -138,7 +264,8 @@ void    PCInterrupt::enable(byte mask)
   {
     byte x;
     // set Port B pins to input mode w/ pullup
-    x=mask&0x7F; DDRB&=~x; PORTB|=x;
+    x=mask&PCPINS; DDRB&=~x; PORTB|=x;
+#if PCHASINT6
     if (mask & 0x80)
     {
       // set ExtInt.6 to input mode w/ pullup
@@ -146,8 +273,9 @@ void    PCInterrupt::enable(byte mask)
       EICRB |= 0x10; // sets the interrupt type (any change)
       EIMSK |= 0x40; // activates the interrupt    
     }
+#endif
     // initialize LastPINB variable
-    LastPINB=(PINB&0x7f)|((PINE&0x40)<<1);
+    LastPINB=PCREAD();
     // setup the Pin change hardware
     if (x) { PCMSK0|=x;  PCICR=1; }
     interrupts();
@@ -160,10 +288,64 @@ void    PCInterrupt::disable(byte mask)
 { 
   if (mask)       // Disable interrupts specified in mask 
   {
-    if (mask&0x7F) { PCMSK0&=(mask&0x7f); if (!PCMSK0) PCICR=0; }
+    if (mask&PCPINS) { PCMSK0&=~(mask&PCPINS); if (!PCMSK0) PCICR=0; }
+#if PCHASINT6
     if (mask&0x80) EIMSK &= ~((mask & 0x80)>>1); 
+#endif
     Changes[0]&=~mask; Changes[1]&=~mask; 
   }
 }
 
 
+
+void    PCInterrupt::attach(byte mask, byte edges, PCPinFunc func)
+  // Call 'func' from the ISR on the 'edges' (PCFALLING, PCRISING or PCCHANGE) 
+  // of the pins specified in 'mask'.  The pins must also be enabled.  A pin 
+  // has only one function, so this replaces any function already attached. 
+{
+  byte n;
+  uint8_t oldSREG = SREG;
+  cli();
+  PCFallMask&=~mask;  PCRiseMask&=~mask;
+  if (func) 
+  {
+    for (n=0; n<8; n++) if (mask & (1<<n)) PCFuncs[n]=func;
+    if (edges & PCFALLING) PCFallMask|=mask;
+    if (edges & PCRISING)  PCRiseMask|=mask;
+  }
+  SREG = oldSREG;
+}
+
+void    PCInterrupt::detach(byte mask)
+  // Stop calling the attached functions for the pins specified in 'mask'. 
+{
+  attach(mask,0,0);
+}
+
+#if PCFIFO
+byte    PCInterrupt::read(struct PCEdge *e)
+  // Copy the oldest edge in the FIFO to *e and remove it.  Returns 0 (and 
+  // leaves *e alone) if the FIFO is empty. 
+{
+  byte n = PCOut;
+  if (n == PCIn) return 0;
+  *e = PCFifo[n & (PCFIFOSIZE-1)];
+  PCOut = n+1;
+  return 1;
+}
+
+byte    PCInterrupt::available(void)
+  // Return the number of edges waiting in the FIFO. 
+{
+  return (byte)(PCIn-PCOut);
+}
+
+byte    PCInterrupt::lost(void)
+  // Return the number of edges dropped because the FIFO was full since the 
+  // last call, and reset the count.  (255 max)
+{
+  byte n;
+  noInterrupts();  n=PCLost;  PCLost=0;  interrupts();
+  return n;
+}
+#endif
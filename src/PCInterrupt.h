@@ -30,6 +30,9 @@
 
 // Pin numbers for each bit position (e.g. arduino pin number)
 // Use these constants for 'mask' values below in the class.
+// (The names are the ATmega32U4 pins.  The bits are PB0..PB7 on all parts:  
+// ATmega328P bits 0..5 are D8..D13 (no bit 7).  ATmega2560 bits 0..7 are 
+// D53, D52, D51, D50, D10, D11, D12, D13 (bit 7 is PB7, not INT6).)
 #define PCINTMASK8  0x10	/* Digital 8  [PB4] */ 
 #define PCINTMASK9  0x20	/* Digital 9  [PB5] */ 
 #define PCINTMASK10 0x40	/* Digital 10 [PB6] */ 
@@ -43,6 +46,45 @@
 // e.g      if (PCH.rising(PCINTMASK10)) { dosomething } 
 // Then don't forget to call PCH.clear(PCINTMASK10);  
 
+// Or attach a function to a pin.  It is called from the ISR on the edges 
+// asked for.  e.g.  PCH.attach(PCINTMASK10,PCFALLING,MyFunc);
+#define PCFALLING   1       /* call on the falling edge */
+#define PCRISING    2       /* call on the rising edge */
+#define PCCHANGE    3       /* call on both edges */
+typedef void (*PCPinFunc)(byte Rising);   // 'Rising' is 1 if the pin went high
+
+// If non-zero then PCChangeIntFunc is only called when a pin with no 
+// attached function changed, instead of on every pin change interrupt. 
+// (Saves the call when only attached pins changed)
+#define PCHOOKSKIP  0
+
+// If non-zero then every pin change interrupt (on the pins with no attached 
+// function) also puts an entry in a FIFO with a time stamp, so the edges are 
+// not lost between polls and each one has its time.  Read them with PCH.read. 
+// (Stamped after the attached functions run, so they aren't delayed by it)
+#define PCFIFO      0
+// Number of entries in the FIFO (power of 2, 128 max). 
+#define PCFIFOSIZE  16
+// If non-zero the time stamp is 32 bits, else only the lower 16 bits (smaller 
+// but rolls over every 262mS with 4uS ticks). 
+#define PCFIFOTS32  1
+
+#if PCFIFO
+#if PCFIFOTS32
+typedef unsigned long PCTime;
+#else
+typedef unsigned int  PCTime;
+#endif
+// One FIFO entry.  'time' is ticks32() when the interrupt started (system timer 
+// ticks, SYSTIMERTICKSPERSEC per second), or micros() if SysTimer doesn't 
+// include the delay functions. 
+struct PCEdge {
+  byte   pins;          // the pins that changed (PCINTMASKxx bits)
+  byte   level;         // the state of all of the pins after the change
+  PCTime time;          // time stamp
+};
+#endif
+
 class PCInterrupt
 {
   public:
@@ -52,13 +94,22 @@ class PCInterrupt
     void    clear(byte mask);    // Clear the interrupt bits in mask
     void    enable(byte mask);   // Enable interrupts on pins in mask
     void    disable(byte mask);  // Disable interrupts on pins in mask
+    void    attach(byte mask, byte edges, PCPinFunc func); 
+                                 // Call func (from the ISR) on 'edges' of the pins in mask
+    void    detach(byte mask);   // Stop calling the functions for the pins in mask
+#if PCFIFO
+    byte    read(struct PCEdge *e);  // Get the oldest edge from the FIFO (0=empty)
+    byte    available(void);     // Return the number of edges in the FIFO
+    byte    lost(void);          // Return (and reset) the edges lost (FIFO full)
+#endif
 };
 
 extern PCInterrupt PCH;   // This is the one (and only) instance of this class
 // You can rename this to whatever you like, if desired. 
 
 // If you define this function, then it will be called as part of 
-// the pin change interrupt service routine
+// the pin change interrupt service routine (Changes has the pins with no 
+// attached function.  With PCHOOKSKIP only if one of them changed)
 extern "C" { void PCChangeIntFunc(byte Changes[]); }
 
 #endif  //_PCINTERRUPT_H
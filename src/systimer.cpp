@@ -46,6 +46,11 @@
 // to use the timer for additional functions. 
 // The "SysTimerIntFunc" function is the form  "void SysTimerIntFunc(void)"
 //
+// When used as the system timer, compare unit B of the timer can also be 
+// armed (SysTimerGateArm) to call "SysTimerGateIntFunc" at a fixed point in 
+// the timer period.  The frequency counter uses this for its gate edges so 
+// they are timed by the hardware instead of by the 1mS interrupt. 
+//
 // When used as the system timer, the timer runs at a fixed 1mS (needed for 
 // delay,millis,micros) and then calls a user function that is set by 
 // "SysTimerIntFunc" (if defined).  
@@ -58,13 +63,35 @@
 // "delayMicroseconds" implements a totally software delay routine.  This code 
 // can be removed if not needed to save space.  "delayMicroseconds" is only 
 // included so that the wiring.c module doesn't get linked in.
+//
+// If "SYSTIMERTICKLESS" is defined as non-zero, the timer doesn't interrupt 
+// every mS.  It runs free and only interrupts when it clears (every 262mS at 
+// 16MHz) and when "SysTimerNext" asks for a call to SysTimerIntFunc.  This 
+// means less interrupts and more sleep time for the processor. 
+//
+// If "SYSTIMERWHEEL" is defined as non-zero, any number of functions can be 
+// called from the timer ISR, each at its own rate (or once), with 
+// "SysTimerAdd".  The timers are kept in a hashed timer wheel so adding, 
+// removing and checking timers each mS takes the same time no matter how 
+// many timers there are.  The timer nodes are static (no malloc). 
+//
+// If "SYSTIMERPLLTS" is defined as non-zero, Timer4 is clocked at 64MHz by 
+// the PLL and "pllticks32" returns the time in 15.6nS counts.  Timer4 is not 
+// extended by interrupts.  Its count is merged with the system timer ticks. 
+//
+// "ticks" returns a 64 bit count of system timer ticks (the timer's full 
+// resolution).  It rolls over with millis (about 50 days), not after 18 
+// minutes like a 32 bit count of 4uS ticks.  ticks/micros/millis do not disable 
+// interrupts.  Instead milliseconds is read until it is the same twice in a 
+// row, so they are safe to call from mainline code and from ISRs. 
 // 
 // This code designed for and tested on a ATMega32U4 processor and the Arduino 
-// Pro Micro module and for use with either Timer1 or Timer3.  It could 
-// probably be used for or reworked for other timers or processors, but that 
-// is beyond the scope of this project.  I attempted to maintain some 
-// compatibility with the original code but the code is untested on other 
-// processors and timers.
+// Pro Micro module and for use with either Timer1 or Timer3.  It also 
+// supports the ATmega2560 (Mega) with Timer1, 3, 4 or 5 (the same 16 bit 
+// timers) and the ATmega328P (Uno) with Timer1 or the 8 bit Timer2.  With 
+// Timer2 the 1mS period must fit in 8 bits (250 ticks at 16MHz and /64, 
+// TIMERPSVALUE 2 or 1 won't work) and SYSTIMERTICKLESS (which needs ICRx) 
+// isn't available.  SYSTIMERPLLTS is ATmega32U4 only. 
 
 /* 
 Revision log: 
@@ -73,12 +100,24 @@ Revision log:
     Reworked to use timer3 and add in all the system delay/millis/micros functions
   1.0.0    3-21-21   REG
     Reworked to use either timer 1 or 3 for the system timer. rework of delay.
+  1.1.0    10-16-26  contrib
+    Added hardware timed gate edge on compare unit B (SYSTIMERGATE).
+    millis/micros no longer disable interrupts. Added 64 bit ticks().
+    micros is correct for any F_CPU (not just those with whole uS ticks).
+    Added tickless mode (SYSTIMERTICKLESS) and SysTimerNext.
+    Added timer wheel (SYSTIMERWHEEL) for many timers on the timer ISR.
+    Allow /8 and /1 timer prescale (TIMERPSVALUE) for finer ticks. ticks32.
+    Added 64MHz Timer4 time stamp (SYSTIMERPLLTS, pllticks32).
+    Added ISR time measurement (ISRStats module).
+    Added CPU load meter tick and idle time in delay (ISRLOAD).
+    ATmega328P (8 bit Timer2 system timer) and ATmega2560 support.
 
 */
 
 
 #include <arduino.h>
 #include "systimer.h"
+#include "ISRStats.h"           // ISR time measurement (if ISRSTATS)
 
 // define (or don't define) this in the header file 
 //#dxfine SYSTIMERINCLUDESDELAY  1    // if defined then include millis / delay and other functions ususally in wiring.c
@@ -89,18 +128,15 @@ Revision log:
                                    // Using SYSTIMERCOMP=1 results in a more 
                                    //   accurate timer and delay function
 
-#define SYSTIMERNO     1           // Use this timer as the system timer (1 or 3)
+// SYSTIMERNO (the timer used as the system timer) is defined in the header file
 
 // *****************************************************************************
 //   Macros to create tokens for register names / bits for the timers. 
 //   These are used in the code so that the timer number used can be changed 
 //   just by changing "SYSTIMERNO" to the timer number to use. 
 // *****************************************************************************
-// PASTETOKENS is used to create token names like TIFR3 from the text "TIFR" and 
-// and the SYSTIMERNO number.  This is a two part operation so that the 
-// precompiler will actually create a token like "TIFR3" from "TIFR" and "3"
-#define PASTER(x,y)       x ## y
-#define PASTETOKENS(x,y)  PASTER(x,y)
+// PASTETOKENS (in the header file) is used to create token names like TIFR3 
+// from the text "TIFR" and the SYSTIMERNO number. 
 
 // System timer is 'a'
 #define TCNTa             PASTETOKENS(TCNT,SYSTIMERNO)
@@ -119,6 +155,29 @@ Revision log:
 #define TOVa              PASTETOKENS(TOV,SYSTIMERNO)
 #define TIMERa_OVF_vect   PASTETOKENS(PASTETOKENS(TIMER,SYSTIMERNO),_OVF_vect) 
 #define TIMERa_COMPA_vect PASTETOKENS(PASTETOKENS(TIMER,SYSTIMERNO),_COMPA_vect) 
+#define OCRaB             PASTETOKENS(PASTETOKENS(OCR,SYSTIMERNO),B)   
+#define OCIEaB            PASTETOKENS(PASTETOKENS(OCIE,SYSTIMERNO),B)   
+#define OCFaB             PASTETOKENS(PASTETOKENS(OCF,SYSTIMERNO),B) 
+#define TIMERa_COMPB_vect PASTETOKENS(PASTETOKENS(TIMER,SYSTIMERNO),_COMPB_vect) 
+
+// Timer2 (ATmega328P) is an 8 bit timer with a different prescaler (it also 
+// has /32 and /128) and its CTC mode bit is in TCCR2A.  TIMERPSVALUE means 
+// the same for all timers (3=/64), SYSTIMERCS converts it to the timer's 
+// clock select bits. 
+#if SYSTIMERNO==2
+#define SYSTIMERCS(P)     (((P)==3)?4:((P)==4)?6:((P)==5)?7:(P))
+#if SYSTIMERTICKS > 256
+#error "Timer2 is 8 bits.  Use a larger prescale (TIMERPSVALUE) or a 16 bit timer"
+#endif
+#if SYSTIMERTICKLESS
+#error "SYSTIMERTICKLESS needs a 16 bit system timer (not Timer2)"
+#endif
+#else
+#define SYSTIMERCS(P)     (P)
+#endif
+#if SYSTIMERPLLTS && !(defined(__AVR_ATmega32U4__) || defined(__AVR_ATmega16U4__))
+#error "SYSTIMERPLLTS needs the ATmega32U4 (Timer4 and the USB PLL)"
+#endif
 
 // The following implements a hook into the ISR for the system timer.  
 // If you define  extern "C" void SysTimerIntFunc(void)  { <some code> }
@@ -131,9 +190,10 @@ extern "C" void SysTimerIntFunc(void) __attribute__ ((weak, alias("__SysTimerISR
 static int Timera_counter;         // value to reload timer with (when in overflow mode)
 #endif
 
-// NOTE: These are coded for Arduino ProMicro/Leonardo with ATMega32u4.  
-// They probably need to be reworked if using on another processor.
+// NOTE: These are coded for Arduino ProMicro/Leonardo with ATMega32u4, and 
+// for the ATmega328P (Timer1 or 2) and ATmega2560 (Timer1, 3, 4 or 5). 
 
+#if !SYSTIMERTICKLESS      // (tickless mode uses SysTimerStart instead)
 #if !SYSTIMERINCLUDESDELAY 
 void StartSysTimer(unsigned int count, byte divisor)
 #else
@@ -152,7 +212,7 @@ static void StartSysTimerLocal(unsigned int count, byte divisor)
   noInterrupts();                  // disable all interrupts
 #if defined(TCCRaB) && defined(CS11) && defined(CS10)
   TCCRaA = 0;  
-  TCCRaB = (divisor&7);            // Prescaler.. 0=timer off, 1=/1,2=/8,3=/64,4=/256,5=/1024,6=/ext fall,7=/ext rise
+  TCCRaB = SYSTIMERCS(divisor&7);  // Prescaler.. 0=timer off, 1=/1,2=/8,3=/64,4=/256,5=/1024,6=/ext fall,7=/ext rise
 #elif defined(TCCRa) && defined(CS11) && defined(CS10)
   TCCRa  = (divisor&7);            // Prescaler.. 0=timer off, 1=/1,2=/8,3=/64,4=/256,5=/1024,6=/ext fall,7=/ext rise
 #endif
@@ -161,7 +221,9 @@ static void StartSysTimerLocal(unsigned int count, byte divisor)
   TCNTa = 0;
   // Dont forget to subtract 1 from the count loaded into OCRaA !!
   OCRaA = count-1;
-#if defined(TCCRaB) && defined(WGMa2)
+#if SYSTIMERNO==2
+  TCCRaA = (1 << WGM21);           // CTC mode (Timer2, WGM22 must stay 0)
+#elif defined(TCCRaB) && defined(WGMa2)
   TCCRaB |= (1 << WGMa2);          // CTC mode
 #endif
   TIMSKa |= (1 << OCIEaA);         // enable timer compare interrupt
@@ -172,6 +234,7 @@ static void StartSysTimerLocal(unsigned int count, byte divisor)
 #endif
   interrupts();                   // enable all interrupts
 }
+#endif  // !SYSTIMERTICKLESS
 
 
 #if !SYSTIMERINCLUDESDELAY
@@ -243,8 +306,7 @@ ISR(TIMERa_COMPA_vect)            // interrupt service routine
 
 #include "wiring_private.h"
 
-#define TIMERCOUNTSPERSEC   1000    // Timer interrupt rate (0.001)
-#define TIMERPSVALUE        3       // Value for timer prescale regisister (/64)
+// TIMERCOUNTSPERSEC and TIMERPSVALUE are defined in the header file.
 
 //#define TIMERISRRATE      0.001   // (not used) interrupt rate for this timer
 //Note: Use integer value for TIMERCOUNTSPERSEC -- not ((int)(1.0/TIMERISRRATE)) 
@@ -252,81 +314,522 @@ ISR(TIMERa_COMPA_vect)            // interrupt service routine
 
 volatile static unsigned long milliseconds=0; // system milliseconds count 
                                               //(used by delay,millis,micros)
+                                              // (Tickless: at start of period)
+
+#if SYSTIMERGATE
+/******************************************************************************/
+/*             Hardware timed gate edge (compare unit B of the timer)          */
+/******************************************************************************/
+
+#if !SYSTIMERCOMP && !SYSTIMERTICKLESS
+#error "SYSTIMERGATE requires the compare (SYSTIMERCOMP) mode system timer"
+#endif
+
+// SYSTIMERGATESYNC converted to timer ticks
+#define GATESYNCTICKS     ((unsigned int)(SYSTIMERGATESYNC*(F_CPU/1000000L)/TIM5PS(TIMERPSVALUE)))
+#if SYSTIMERGATESYNC>50
+#error "SYSTIMERGATESYNC is the compare B ISR spin time, keep it 50uS or less"
+#endif
+
+// Same as SysTimerIntFunc... If you define 
+//   extern "C" void SysTimerGateIntFunc(unsigned int Late) { <some code> }
+// then that function will be called by the compare B ISR.  
+extern "C" void __SysTimerGateEmpty(unsigned int Late __attribute__((unused))) { }
+extern "C" void SysTimerGateIntFunc(unsigned int Late) __attribute__ ((weak, alias("__SysTimerGateEmpty")));
+
+#if SYSTIMERTICKLESS
+// In tickless mode SysTimerIntFunc is called at the exact time asked for, so 
+// the gate edge is synchronized to that time instead (see SysTimerCall) and 
+// compare unit B isn't needed. 
+static byte GateArmed;          // call SysTimerGateIntFunc after SysTimerIntFunc
+
+void SysTimerGateArm(void)
+  // Call "SysTimerGateIntFunc" right after SysTimerIntFunc returns.  (Call 
+  // only from SysTimerIntFunc) 
+{
+  GateArmed = 1;
+}
+
+#else   // !SYSTIMERTICKLESS
+
+// Compare B matches half way between the system timer interrupts so the two 
+// ISRs don't compete with each other. 
+#define GATEPHASE         (SYSTIMERTICKS/2)
+
+static byte GateSlip;         // non-zero if armed after the compare point
+
+
+void SysTimerGateArm(void)
+  // Arm compare unit B of the system timer.  "SysTimerGateIntFunc" will be 
+  // called (once) from the compare B ISR at a fixed point in the current 
+  // timer period.
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  OCRaB = GATEPHASE; 
+  // If we are already past the compare point (the timer ISR was very late) 
+  // the match happens in the next period.  Remember this so 'Late' includes it. 
+  GateSlip = (TCNTa >= GATEPHASE);
+  TIFRa = (1<<OCFaB);             // clear old compare flag 
+  TIMSKa |= (1<<OCIEaB);          // enable timer compare B interrupt
+  SREG = oldSREG;
+}
+
+
+ISR(TIMERa_COMPB_vect)        // interrupt service routine (gate edge)
+{
+  ISRSTAT_ENTERAT(ISRID_GATEEDGE,GATEPHASE);
+  unsigned int ctr = TCNTa;
+  TIMSKa &= ~(1<<OCIEaB);     // one shot... disable until armed again
+  // ctr = number of ticks since the compare match.  (If the timer cleared 
+  // since the match, add the timer period back in.)
+  if (ctr < GATEPHASE) ctr += SYSTIMERTICKS;
+  ctr -= GATEPHASE; 
+  if (ctr < GATESYNCTICKS)
+  {
+    // We got here in time.  Wait for the sync point so that the gate edge 
+    // happens a fixed number of CPU cycles after the compare match.  (At 
+    // most GATESYNCTICKS, SYSTIMERGATESYNC uS, with interrupts off.  The 
+    // sync point is well before the timer clears, half a period later) 
+    while (TCNTa < (GATEPHASE+GATESYNCTICKS)) ;
+    ctr = GATESYNCTICKS;
+  }
+  if (GateSlip) ctr += SYSTIMERTICKS;
+  SysTimerGateIntFunc(ctr);   // call the user defined function (if defined)
+  ISRSTAT_EXIT(ISRID_GATEEDGE);
+}
+#endif  // SYSTIMERTICKLESS
+#endif  // SYSTIMERGATE
+
+
+#if SYSTIMERWHEEL
+/******************************************************************************/
+/*                     Timer wheel (many timers on one ISR)                    */
+/******************************************************************************/
+
+#if SYSTIMERTICKLESS
+#error "SYSTIMERWHEEL needs the 1mS system timer interrupt (not SYSTIMERTICKLESS)"
+#endif
+#if (SYSTIMERSLOTS & (SYSTIMERSLOTS-1))
+#error "SYSTIMERSLOTS must be a power of 2"
+#endif
+
+// Each timer is in the slot for the mS it is due in (modulo SYSTIMERSLOTS) 
+// with the number of turns of the wheel left before it's due.  Each mS the 
+// ISR only looks at the timers in one slot.  The lists are doubly linked (by 
+// 'pprev') so a timer can be removed without searching for it. 
+static SysTimerNode *WheelSlot[SYSTIMERSLOTS];
+static SysTimerNode *WheelNext;   // next node to look at in SysTimerWheelTick
+
+
+static void SysTimerLink(SysTimerNode *node, unsigned int ms)
+  // Put 'node' in the slot for 'ms' mS from now.  Call with interrupts off.
+{
+  SysTimerNode **head;
+  if (!ms) ms=1;                  // (this mS is already here)
+  node->rounds = (ms-1)/SYSTIMERSLOTS;
+  head = &WheelSlot[(unsigned int)(milliseconds+ms) & (SYSTIMERSLOTS-1)];
+  node->next = *head;  
+  if (node->next) node->next->pprev = &node->next;
+  node->pprev = head;  *head = node;
+}
+
+
+static void SysTimerUnlink(SysTimerNode *node)
+  // Take 'node' off the wheel.  Call with interrupts off.
+{
+  if (!node->pprev) return;       // not running
+  if (WheelNext == node) WheelNext = node->next;  // (removed from a callback)
+  *node->pprev = node->next;
+  if (node->next) node->next->pprev = node->pprev;
+  node->pprev = 0;
+}
+
+
+void SysTimerAdd(SysTimerNode *node, unsigned int ms, 
+                 unsigned int period, void (*func)(void))
+  // Call 'func' from the system timer ISR 'ms' mS from now and then every 
+  // 'period' mS after that (or only once if period is 0). 
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  SysTimerUnlink(node);
+  node->func = func;  node->period = period;
+  SysTimerLink(node, ms);
+  SREG = oldSREG;
+}
+
+
+void SysTimerRemove(SysTimerNode *node)
+  // Stop the timer 'node' (if it's running). 
+{
+  uint8_t oldSREG = SREG;
+  cli();  SysTimerUnlink(node);  SREG = oldSREG;
+}
+
+
+byte SysTimerActive(SysTimerNode *node) { return node->pprev!=0; }
+  // Returns non-zero if the timer 'node' is running.
+
 
+static inline void SysTimerWheelTick(void)
+  // Called by the timer ISR each mS (after milliseconds is incremented).  
+  // Call the functions for the timers that are due in this mS. 
+{
+  SysTimerNode *node;
+  WheelNext = WheelSlot[(unsigned int)milliseconds & (SYSTIMERSLOTS-1)];
+  while ((node = WheelNext))
+  {
+    WheelNext = node->next;
+    if (node->rounds) { node->rounds--; continue; }
+    SysTimerUnlink(node);
+    if (node->period) SysTimerLink(node, node->period);  // (no drift)
+    node->func();
+  }
+}
+#endif  // SYSTIMERWHEEL
+
+
+#if !SYSTIMERTICKLESS
 #if !SYSTIMERCOMP             
 ISR(TIMERa_OVF_vect)          // interrupt service routine (once per mS)
 #else
 ISR(TIMERa_COMPA_vect)        // interrupt service routine (once per mS) 
 #endif
 {
+  ISRSTAT_ENTERAT(ISRID_SYSTIMER,0);
 #if !SYSTIMERCOMP
   // The next line should be  "TCNTa += Timera_counter", but then the timer 
   // runs too slow. So just reload the TCNT register with the count (FF06)(-250)
   TCNTa = Timera_counter;     // reload timer (reload value plus timer residual)
 #endif  
   milliseconds++;
+  ISRLOAD_TICK();              // CPU load meter (if ISRLOAD)
+#if SYSTIMERWHEEL
+  SysTimerWheelTick();         // call the timers that are due
+#endif
   SysTimerIntFunc();           // call the user defined function (if defined)
+  ISRSTAT_EXIT(ISRID_SYSTIMER);
 }
 
+#else   // SYSTIMERTICKLESS
 
-unsigned long millis() 
-  // Return the number of milliseconds since we started running.  
-  // (Rolls over about every 50 days)
+/******************************************************************************/
+/*        Tickless system timer (interrupt only when there is work to do)      */
+/******************************************************************************/
+
+// The timer runs in CTC mode with TOP=ICRa so it clears every SYSTIMERPERIODMS
+// mS (as many whole mS as fit in 16 bits, 262mS at 16MHz).  The capture ISR 
+// (at TOP) adds SYSTIMERPERIODMS to milliseconds, so milliseconds is the mS 
+// count at the start of the current timer period and the rest of the time is 
+// in the timer counter.  Compare unit A is set for the next SysTimerIntFunc 
+// call (SysTimerNext), if it is in the current timer period. 
+// (SYSTIMERPERIODMS and SYSTIMERPERIOD are in the header file)
+
+#define ICRa              PASTETOKENS(ICR,SYSTIMERNO)
+#define ICIEa             PASTETOKENS(ICIE,SYSTIMERNO)
+#define ICFa              PASTETOKENS(ICF,SYSTIMERNO)
+#define WGMa3             PASTETOKENS(PASTETOKENS(WGM,SYSTIMERNO),3)   
+#define TIMERa_CAPT_vect  PASTETOKENS(PASTETOKENS(TIMER,SYSTIMERNO),_CAPT_vect) 
+
+static unsigned long NextCall;  // mS count of the next SysTimerIntFunc call
+static byte NextState;          // 0=no call, 1=waiting, 2=call it now
+static byte InHook;             // non-zero while calling SysTimerIntFunc
+
+static void SysTimerStart(void)
+  // Start the timer free running (CTC mode, TOP=ICRa) with the capture 
+  // interrupt (at TOP) on.  Compare A is turned on by SysTimerNext.
 {
-  // disable interrupts while we read timer0_millis or we might get an
-  // inconsistent value (e.g. in the middle of a write to timer0_millis)
-  uint8_t oldSREG = SREG; unsigned long t;
-  cli();  t = milliseconds;  SREG = oldSREG;
-  return t; 
+  noInterrupts();
+  TCCRaA = 0;  TCCRaB = 0;
+  TCNTa = 0;
+  ICRa = SYSTIMERPERIOD-1;
+  TIFRa = (1<<ICFa)|(1<<OCFaA);
+  TIMSKa = (1<<ICIEa);
+  TCCRaB = (1<<WGMa3)|(1<<WGMa2)|TIMERPSVALUE;  // CTC (TOP=ICR), prescale
+  interrupts();
 }
 
 
-unsigned long micros() 
-  // Return the number of microseconds since we started running. 
-  // (rolls over about every 70min)
-  // This is done by returning the number of milliseconds (*1000) plus the 
-  // value in the timer counter register * uS/count
+static void SysTimerArmNext(void)
+  // Set compare unit A for NextCall if it is in this timer period. If it's 
+  // already here (or past), set NextState to 2.  Call with interrupts off.
 {
-  uint8_t oldSREG = SREG; unsigned int ctr; unsigned long m; 
-#if SYSTIMERCOMP
-  // ints off, read milliseconds variable and timer(ctr) 
-  cli();  m = milliseconds;  ctr = TCNTa;   
-  // If timer cleared after reading milliseconds then add 1 to our copy of 
-  // milliseconds (any additional counts still remain in ctr)
-  // (8 is some 'cushion' because timer is still counting during reading milliseconds)
-  if (ctr<8 && (TIFRa & (1<<OCFaA))) { m++; }
-  SREG = oldSREG;         // interrupts back on (if they were)
+  unsigned long off = NextCall-milliseconds;   // mS from start of period
+  unsigned int ocr;
+  TIMSKa &= ~(1<<OCIEaA);
+  NextState = 1;
+  if ((long)off < 0) { NextState = 2; return; }
+  if (off >= SYSTIMERPERIODMS) return;         // not this period
+  ocr = (unsigned int)off*SYSTIMERTICKS;
+  if (ocr <= TCNTa) { NextState = 2; return; }
+  OCRaA = ocr;
+  TIFRa = (1<<OCFaA);
+  TIMSKa |= (1<<OCIEaA);
+  // If the timer got to 'ocr' while we were setting it, the match was missed
+  if (TCNTa >= ocr && !(TIFRa & (1<<OCFaA))) NextState = 2;
+}
+
+
+static void SysTimerCall(void)
+  // Call SysTimerIntFunc (again if it asked for a time that already passed).
+{
+  while (NextState == 2)
+  {
+    NextState = 0;
+#if SYSTIMERGATE
+    // Save the time this call was for (SysTimerIntFunc may change NextCall)
+    long due = (long)(milliseconds-NextCall)*SYSTIMERTICKS;
+#endif
+    InHook = 1;
+    SysTimerIntFunc();         // call the user defined function (if defined)
+    InHook = 0;
+#if SYSTIMERGATE
+    if (GateArmed)
+    {
+      // 'due' + TCNTa is the number of ticks since the time this call was for.
+      // If we are in time, wait until GATESYNCTICKS after it so the gate edge 
+      // is always at the same point.  Otherwise report how late we are.
+      unsigned int ctr;
+      GateArmed = 0;
+      while ((due+TCNTa) < GATESYNCTICKS && !(TIFRa & (1<<ICFa))) ;
+      ctr = TCNTa;
+      // (If SysTimerIntFunc took so long the timer cleared, count the period)
+      if ((TIFRa & (1<<ICFa)) && ctr<(SYSTIMERPERIOD/2)) ctr += SYSTIMERPERIOD;
+      due += ctr; 
+      SysTimerGateIntFunc((due > 32767) ? 32767 : due);
+    }
+#endif
+  }
+}
+
+
+ISR(TIMERa_CAPT_vect)         // interrupt service routine (once per period)
+{
+  ISRSTAT_ENTERAT(ISRID_SYSTIMER,0);
+  milliseconds += SYSTIMERPERIODMS;
+  if (NextState) 
+  {
+    SysTimerArmNext();
+    SysTimerCall();
+  }
+  ISRSTAT_EXIT(ISRID_SYSTIMER);
+}
+
+
+ISR(TIMERa_COMPA_vect)        // interrupt service routine (at NextCall)
+{
+  ISRSTAT_ENTERAT(ISRID_SYSTIMER,OCRaA);
+  TIMSKa &= ~(1<<OCIEaA);     // one shot... 
+  NextState = 2;
+  SysTimerCall();
+  ISRSTAT_EXIT(ISRID_SYSTIMER);
+}
+
+
+void SysTimerNext(unsigned long ms)
+  // Call SysTimerIntFunc 'ms' mS from now.  If called from SysTimerIntFunc 
+  // then it is 'ms' after the time that call was for (so there is no drift).
+  // Each call replaces the time set by the last one. 
+{
+  uint8_t oldSREG = SREG; unsigned int ctr;
+  cli();
+  if (InHook) { NextCall += ms;  SysTimerArmNext(); } // (SysTimerCall calls again if past)
+  else 
+  {
+    // From now.  At least the next mS, since this one has already started.
+    ctr = TCNTa;
+    if ((TIFRa & (1<<ICFa)) && ctr<(SYSTIMERPERIOD/2)) ctr += SYSTIMERPERIOD;
+    NextCall = milliseconds + ctr/SYSTIMERTICKS + (ms ? ms : 1); 
+    SysTimerArmNext();
+    // If we just missed it, try one mS later.
+    while (NextState == 2) { NextCall++; SysTimerArmNext(); }
+  }
+  SREG = oldSREG;
+}
+#endif  // SYSTIMERTICKLESS
+
+
+
+
+// Micros per timer tick as a fixed point (21 bit fraction) multiplier, 
+// rounded up so that the last tick in each mS is still less than 1000uS. 
+// (ctr*USPERTICK)>>21 is exactly ctr*1000/SYSTIMERTICKS (rounded down) for 
+// any SYSTIMERTICKS less than 1448 and never more than 1uS high above that. 
+#define USPERTICK   ((unsigned long)((1000ULL<<21)+SYSTIMERTICKS-1)/SYSTIMERTICKS)
+
+#if (F_CPU/TIM5PS(TIMERPSVALUE)/TIMERCOUNTSPERSEC) > 65536
+#error "Too many system timer ticks per mS.  Use a larger prescale (TIMERPSVALUE)"
+#endif
+#if ((F_CPU/TIM5PS(TIMERPSVALUE)) % TIMERCOUNTSPERSEC) != 0
+#warning "System timer ticks per mS is not an integer, millis/micros/ticks will drift"
+#endif
+
+
+static inline unsigned long SysTimerRead(unsigned int *pctr)
+  // Return the number of milliseconds and (in *pctr) the number of timer ticks
+  // since then, without disabling interrupts.  milliseconds is read twice and 
+  // if the timer ISR changed it between the two reads then read it all again. 
+  // If called with interrupts off (like from an ISR) milliseconds can't 
+  // change, so the compare flag is checked to see if the timer cleared 
+  // without the timer ISR having counted it yet. 
+{
+  unsigned long m; unsigned int ctr; 
+#if SYSTIMERTICKLESS || SYSTIMERCOMP
+  byte flag;
+  do {
+    m = milliseconds;  ctr = TCNTa;  flag = TIFRa;
+  } while (m != milliseconds);
+#else
+  do {
+    m = milliseconds;  ctr = TCNTa;
+  } while (m != milliseconds);
+#endif
+#if SYSTIMERTICKLESS
+  // Same as below, but the timer period is SYSTIMERPERIODMS mS (and ctr is 
+  // the number of ticks since the start of the period)
+  if ((flag & (1<<ICFa)) && ctr<(SYSTIMERPERIOD/2)) { m+=SYSTIMERPERIODMS; }
+#elif SYSTIMERCOMP
+  // If the timer cleared but the ISR has not run yet then add 1 to our 
+  // copy of milliseconds.  If ctr is in the upper half of the period then 
+  // it was read before the timer cleared and doesn't need this.  
+  if ((flag & (1<<OCFaA)) && ctr<(SYSTIMERTICKS/2)) { m++; }
 #else
   // NOTE: if using overflow mode (not comparemode) then should have set ctr to 
   // "Timera_counter" instead of 0  then adjust ctr downward to 0 
   // ( Ctr=-Timera_counter+ctr  ) before adding adding it to m*1000... 
-  cli();  m = milliseconds;  ctr = TCNTa;  // ints off, read milliseconds and timer
-  SREG = oldSREG;                          // interrupts back on (if they were)
-  //
   // Since ctr counts from FF06 up, even if we roll over, the count is still 
   // correct for determining the partial number of uS counts beyond the "m" value.  
   // Do NOT add 1 to m like we do in the SYSTIMERCOMP version (ctr already includes it)
   // Timera_counter is initialized to -250 (FF06).
   ctr = ctr-(unsigned)Timera_counter;      // same as (-Timera_counter)+ctr; 
 #endif 
+  *pctr = ctr;
+  return m;
+}
+
+
+unsigned long millis() 
+  // Return the number of milliseconds since we started running.  
+  // (Rolls over about every 50 days)
+{
+  // Read milliseconds until we get the same value twice in a row so we 
+  // don't return an inconsistent value (e.g. in the middle of a write to 
+  // milliseconds by the timer ISR).  No need to disable interrupts.
+  unsigned long t;
+#if SYSTIMERTICKLESS
+  unsigned int ctr;
+  t = SysTimerRead(&ctr);
+  t += ctr/SYSTIMERTICKS;               // add mS since start of timer period
+#else
+  do { t = milliseconds; } while (t != milliseconds);
+#endif
+  return t; 
+}
+
+
+unsigned long micros() 
+  // Return the number of microseconds since we started running. 
+  // (rolls over about every 70min)
+  // This is done by returning the number of milliseconds (*1000) plus the 
+  // value in the timer counter register * uS/count
+{
+  unsigned int ctr; unsigned long m; 
+  m = SysTimerRead(&ctr);
+#if SYSTIMERTICKLESS
+  m += ctr/SYSTIMERTICKS;  ctr %= SYSTIMERTICKS;
+#endif
   // m = The number of mS*1000 plus the partial value in the timer register 
-  // (will be 0...249) times the number of uS per timer count.   
-  // Note: Multiply 0..249 times 4 (for prescale of 3)
-  // (1.0/(F_CPU/64)*1000000) is number of uS per timer count (4)
-  m=(m*TIMERCOUNTSPERSEC) + (ctr*(unsigned int)(1.0/(F_CPU/TIM5PS(TIMERPSVALUE))*1000000));
-  return m; 
+  // (0...SYSTIMERTICKS-1) converted to uS.  (ctr*4 for 16MHz and /64)
+  return (m*1000) + (unsigned int)(((unsigned long)ctr*USPERTICK)>>21);
+}
+
+
+unsigned long long ticks() 
+  // Return the number of system timer ticks since we started running. 
+  // (SYSTIMERTICKSPERSEC per second, 4uS each at 16MHz and /64)
+  // This is milliseconds*SYSTIMERTICKS plus the timer counter register.  
+  // (rolls over with milliseconds, about every 50 days)
+{
+  unsigned int ctr; unsigned long m; 
+  m = SysTimerRead(&ctr);
+  // Do this as two 16x16 bit multiplies instead of a (slow) 64 bit multiply.
+  return (((unsigned long long)((m>>16)*SYSTIMERTICKS))<<16) + 
+         ((m&0xFFFF)*SYSTIMERTICKS) + ctr;
 }
 
 
+unsigned long ticks32() 
+  // Return the lower 32 bits of ticks().  
+{
+  unsigned int ctr; unsigned long m; 
+  m = SysTimerRead(&ctr);
+  return (m*SYSTIMERTICKS) + ctr;
+}
+
+
+#if SYSTIMERPLLTS
+/******************************************************************************/
+/*               64MHz time stamp (Timer4 clocked by the USB PLL)              */
+/******************************************************************************/
+
+// Timer4 counts the 64MHz PLL clock and rolls over every 1024 counts (16uS) 
+// without interrupting.  The system timer ticks give the rest of the time.
+// Both clocks come from the same crystal, so the Timer4 count minus the 
+// system timer ticks (in Timer4 counts) is always the same (PLLOffset).  
+// The coarse time (ticks+PLLOffset) is within one tick of the Timer4 count,
+// so the lower 10 bits of the Timer4 count can replace its lower bits. 
+#define PLLTSRATIO        (SYSTIMERPLLTPS/SYSTIMERTICKSPERSEC)  // Timer4 counts/tick
+#if (SYSTIMERPLLTPS % SYSTIMERTICKSPERSEC) || (PLLTSRATIO > 256)
+#error "SYSTIMERPLLTS needs a system timer prescale of /64 or less (TIMERPSVALUE 1..3)"
+#endif
+// PLL 96MHz, USB gets PLL/2 (48MHz), Timer4 gets PLL/1.5 (64MHz)
+#define PLLFRQTS          ((1<<PLLUSB)|(1<<PLLTM1)|(1<<PDIV3)|(1<<PDIV1))
+#define PLLFRQTSMSK       ((1<<PLLTM1)|(1<<PLLTM0)|(1<<PDIV3)|(1<<PDIV2)|(1<<PDIV1)|(1<<PDIV0))
+
+static unsigned int PLLOffset;    // Timer4 count - ticks*PLLTSRATIO (mod 1024)
+static byte PLLCal;               // non-zero if PLLOffset is good
+
+
+unsigned long pllticks32()
+  // Return the time in 64MHz (15.6nS) counts.  (lower 32 bits, rolls over 
+  // every 67 sec)  If the PLL isn't running at 96MHz (USB turned it off or 
+  // changed it), this is ticks32() converted to 64MHz counts. 
+{
+  unsigned int ctr, f; int d; unsigned long t; 
+  uint8_t oldSREG = SREG;
+  cli();
+  t = SysTimerRead(&ctr);
+  f = TCNT4;  f |= (unsigned int)TC4H<<8;     // (must read low byte first)
+  SREG = oldSREG;
+  t = ((t*SYSTIMERTICKS) + ctr)*PLLTSRATIO;   // ticks in Timer4 counts
+  if ((PLLCSR & (1<<PLOCK)) && (PLLFRQ & PLLFRQTSMSK)==(PLLFRQTS & PLLFRQTSMSK))
+  {
+    // Get the offset the first time after the PLL (and Timer4) start
+    if (!PLLCal) { PLLOffset = (f-(unsigned int)t) & 1023;  PLLCal = 1; }
+    t += PLLOffset;
+    // Correct the coarse time with the Timer4 count (-512..511 counts)
+    d = (f-(unsigned int)t) & 1023;  if (d >= 512) d -= 1024;
+    t += d;
+  }
+  else PLLCal = 0;                // not running.. get a new offset later
+  return t;
+}
+#endif  // SYSTIMERPLLTS
+
+
 void delay(unsigned long ms)
   // Delay specified number of milliseconds. 'ms' is the number of mS to delay. 
   // Call 'yield' while delaying.
 {
 #if 10          // Quicker... Save about 130 bytes
   unsigned long start = millis();
+  ISRLOAD_IDLEBEGIN();
   while (ms>0 && (millis()-start) < ms) { yield(); }
+  ISRLOAD_IDLEEND();
 #else           // do it per the original code
   unsigned long start = micros();
+  ISRLOAD_IDLEBEGIN();
   while (ms > 0) {
     yield();
     while ( ms > 0 && (micros() - start) >= 1000) {
@@ -334,6 +837,7 @@ void delay(unsigned long ms)
       start += 1000;
     }
   }
+  ISRLOAD_IDLEEND();
 #endif
 }
 
@@ -514,7 +1018,20 @@ void init(void)
 // ***************************  Timer4 setup  **********************************
 
 /* beginning of timer4 block for 32U4 and similar */
-#if (SYSTIMERNO!=4) && defined(TCCR4A) && defined(TCCR4B) && defined(TCCR4D) 
+#if SYSTIMERPLLTS
+  // Timer4 free runs from the PLL (64MHz) for pllticks32.  Start the PLL 
+  // at 96MHz with USB at /2 (USB setup leaves this alone) and Timer4 at /1.5. 
+  PLLFRQ = PLLFRQTS;
+#if F_CPU == 16000000L
+  PLLCSR = (1<<PINDIV)|(1<<PLLE);             // 16MHz xtal /2 into the PLL
+#else
+  PLLCSR = (1<<PLLE);
+#endif
+  TCCR4A=0;  TCCR4C=0;  TCCR4D=0;  TCCR4E=0;  // normal mode, no outputs
+  TC4H=3;  OCR4C=0xFF;                        // TOP=1023
+  TC4H=0;  TCNT4=0;
+  TCCR4B=(1<<CS40);                           // PLL clock /1
+#elif (SYSTIMERNO!=4) && defined(TCCR4A) && defined(TCCR4B) && defined(TCCR4D) 
   //sbi(TCCR4B, CS42);    // set timer4 prescale factor to 64
   //sbi(TCCR4B, CS41);
   //sbi(TCCR4B, CS40);
@@ -543,8 +1060,13 @@ void init(void)
 
 #endif    // Skip other timers
 
+#if SYSTIMERTICKLESS
+// Now start up the system timer (free running)
+  SysTimerStart();
+#else
 // Now start up the system timer to 'TIMERCOUNTSPERSEC' rate
   StartSysTimerLocal(SYSTIMERSPEED((1.0/TIMERCOUNTSPERSEC),TIMERPSVALUE));
+#endif
 
 // *******************************  ADC setup **********************************
 //
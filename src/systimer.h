@@ -35,6 +35,14 @@
 // if defined then include millis/delay and other functions usually in wiring.c
 #define SYSTIMERINCLUDESDELAY  1   
 
+// Use this timer as the system timer.  ATmega32U4: 1 or 3.  ATmega2560: 1, 3, 
+// 4 or 5.  ATmega328P: 1 or 2 (2 is 8 bits, so Timer1 is free for counting). 
+#if defined(__AVR_ATmega328P__) || defined(__AVR_ATmega168__)
+#define SYSTIMERNO             2   
+#else
+#define SYSTIMERNO             1   
+#endif
+
 #if !SYSTIMERINCLUDESDELAY
 
 void StartSysTimer(unsigned int count, byte divisor);
@@ -61,8 +69,8 @@ void StopSysTimer(void);
 // If replacing wiring.c (in default library) these functions are defined 
 // in the cpp file
 
-// NOTE: These are coded for Arduino ProMicro/Leonardo with ATMega32u4.  
-// They may need to be reworked if using on another processor.
+// NOTE: These are coded for Arduino ProMicro/Leonardo with ATMega32u4, and 
+// also work on the ATmega328P (Uno) and ATmega2560 (Mega).  
 
 extern unsigned long millis();
 // Return the number of milliseconds since we started running.  
@@ -72,6 +80,18 @@ extern unsigned long micros();
 // Return the number of microseconds since we started running. 
 // (rolls over about every 70min)
 
+extern unsigned long long ticks(); 
+// Return the number of system timer ticks since we started running.  This is 
+// the full resolution of the timer (4uS at 16MHz).  It is built from the 32 
+// bit millisecond count, so it rolls over with millis (about every 50 days). 
+// (SYSTIMERTICKSPERSEC ticks per second)
+
+extern unsigned long ticks32(); 
+// Same as ticks() but only the lower 32 bits (faster).  Rolls over (about 
+// every 4.8 hours at /64, 36 minutes at /8, 4.5 minutes at /1 @16MHz), but 
+// the difference between two readings is correct for intervals shorter 
+// than that. 
+
 extern void delay(unsigned long ms);
 // Delay for the number of ms specified.
 
@@ -82,12 +102,130 @@ extern void init(void);
 // This version does NOT include all of the normal PWM initialization like 
 // the default library wiring.c version does. 
 
+#define TIMERCOUNTSPERSEC   1000    // Timer interrupt rate (0.001)
+// Value for timer prescale register: 3=/64 (4uS ticks @16MHz), 2=/8 (0.5uS 
+// ticks), 1=/1 (62.5nS ticks).  The timer still interrupts once per mS, 
+// this just sets the resolution of ticks() (and the period measurement). 
+// (With SYSTIMERTICKLESS the timer clears every 32mS at /8, every 4mS at /1)
+#define TIMERPSVALUE        3       // Value for timer prescale regisister (/64)
+
+// Number of timer counts (ticks) in each timer interrupt period (250 @16MHz)
+#define SYSTIMERTICKS       (F_CPU/TIM5PS(TIMERPSVALUE)/TIMERCOUNTSPERSEC)
+// Number of timer ticks per second (the rate of ticks())
+#define SYSTIMERTICKSPERSEC (F_CPU/TIM5PS(TIMERPSVALUE))
+
+// If non-zero then compare unit B of the system timer is used to time the 
+// frequency counter gate edges in hardware.  (See SysTimerGateArm)  Off by 
+// default: it changes the gate timing and the compare B ISR spins for up to 
+// SYSTIMERGATESYNC uS once per gate (not every mS). 
+#define SYSTIMERGATE        0
+
+// Number of uS after the compare B match that the gate edge is held back to. 
+// If the ISR starts within this time, it waits for this point so that every 
+// gate edge happens the same number of CPU cycles after the compare match.  
+// If the ISR starts later than this (USB interrupt, etc.), the extra latency 
+// is reported to SysTimerGateIntFunc so the gate length can be corrected.  
+// This wait is the longest time other interrupts are held off by the 
+// compare B ISR (plus the gate work), so keep it short.  (2..50)
+#define SYSTIMERGATESYNC    12
+
+// If non-zero then the timer only interrupts when there is something to do 
+// instead of every mS.  It runs free (clearing every 262mS at 16MHz) and 
+// millis/micros/ticks are the mS count at the start of the timer period plus 
+// the timer count.  SysTimerIntFunc is NOT called every mS.  It is only 
+// called at the time asked for by SysTimerNext.  
+#define SYSTIMERTICKLESS    0
+
+// Number of timer ticks from one timer clear to the next (the timer period)
+#if SYSTIMERTICKLESS
+#define SYSTIMERPERIODMS    (65536/SYSTIMERTICKS)
+#define SYSTIMERPERIOD      (SYSTIMERPERIODMS*SYSTIMERTICKS)
+#else
+#define SYSTIMERPERIOD      SYSTIMERTICKS
+#endif
+// The system timer count register (e.g. for time stamps in ISRs)
+#define SYSTIMERTCNT        PASTETOKENS(TCNT,SYSTIMERNO)
+
+// If non-zero then Timer4 (ATmega32U4 only) is clocked at 64MHz from the USB 
+// PLL for a 15.6nS time stamp (pllticks32).  No Timer4 PWM (D6,D10,D13). 
+#define SYSTIMERPLLTS       0
+#define SYSTIMERPLLTPS      64000000L // pllticks32 counts per second
+
+// If non-zero then include the timer wheel (SysTimerAdd/SysTimerRemove) so 
+// many functions can be called from the timer ISR, each at its own rate, 
+// without chaining them all in SysTimerIntFunc.  (Not with SYSTIMERTICKLESS)
+#define SYSTIMERWHEEL       0
+// Number of slots in the timer wheel (power of 2).  Each mS only the timers in 
+// one slot are looked at, so more slots = less time in the ISR each mS.
+#define SYSTIMERSLOTS       16
+
+#if SYSTIMERGATE
+extern void SysTimerGateArm(void);
+// Arm compare unit B of the system timer.  "SysTimerGateIntFunc" will be 
+// called (once) from the compare B ISR at a fixed point in the current timer 
+// period.  Normally called from SysTimerIntFunc (e.g. just after the timer 
+// interrupt) so the compare point in this period hasn't passed yet.
+
+// If you define this function, then it will be called by the compare B ISR 
+// after SysTimerGateArm.  'Late' is the number of timer ticks from the compare 
+// match to the gate edge.  (SYSTIMERGATESYNC converted to ticks unless the 
+// ISR was held off longer than that.)
+extern "C" { extern void SysTimerGateIntFunc(unsigned int Late); }
+#endif
+
+#if SYSTIMERPLLTS
+extern unsigned long pllticks32();
+// Return the time in 64MHz counts (15.6nS).  Only the lower 32 bits, so it 
+// rolls over every 67 seconds, but differences are correct.  If the PLL is 
+// off (or USB changed it) it falls back to ticks32() in 64MHz counts. 
+#endif
+
+#if SYSTIMERWHEEL
+// One timer on the wheel.  Allocate these statically (one per function to be 
+// called) and don't touch the fields.  Zero (static) initialized is fine.
+typedef struct SysTimerNode {
+  struct SysTimerNode *next;          // list of timers in the same slot
+  struct SysTimerNode **pprev;        // -> the pointer to this node (0=off)
+  void (*func)(void);                 // function to call
+  unsigned int period;                // mS between calls (0=call once)
+  unsigned int rounds;                // turns of the wheel before it's due
+} SysTimerNode;
+
+extern void SysTimerAdd(SysTimerNode *node, unsigned int ms, 
+                        unsigned int period, void (*func)(void));
+// Call 'func' from the system timer ISR 'ms' mS from now and then every 
+// 'period' mS after that (or only once if period is 0).  If 'node' is already 
+// running it is restarted with the new values.  Takes the same (short) time 
+// no matter how many timers there are.  'func' may add or remove timers 
+// (including its own). 
+
+extern void SysTimerRemove(SysTimerNode *node);
+// Stop the timer 'node' (if it's running). 
+
+extern byte SysTimerActive(SysTimerNode *node);
+// Returns non-zero if the timer 'node' is running.
+#endif
+
+#if SYSTIMERTICKLESS
+extern void SysTimerNext(unsigned long ms);
+// Call SysTimerIntFunc (once) 'ms' mS from now.  When called from inside 
+// SysTimerIntFunc the time is from the time of that call (not from when it 
+// actually ran) so a recurring call doesn't drift.  Only the last time set is 
+// used.  SysTimerIntFunc must call this again if it wants to be called again. 
+#endif
+
 #endif 
 
 // If you define this function, then it will be called as part of the Timer 
 // interrupt service routine
 extern "C" { extern void SysTimerIntFunc(void); }
 
+// PASTETOKENS is used to create token names like TIFR3 from the text "TIFR" and 
+// and the SYSTIMERNO number.  This is a two part operation so that the 
+// precompiler will actually create a token like "TIFR3" from "TIFR" and "3"
+#define PASTER(x,y)       x ## y
+#define PASTETOKENS(x,y)  PASTER(x,y)
+
 /******************************************************************************/
 /*               Macros to set the timer speed (count and prescale)           */ 
 /******************************************************************************/